@@ -9,7 +9,7 @@ ARCH = {
 	'i386': 'X86_32',
 	'x86': 'X86_32',
 }
-CC = ['cc', '-D_GNU_SOURCE', '-Wno-nonnull', '-x', 'c', '-o', '/dev/null', '-', '-ldl']
+CC = ['cc', '-D_GNU_SOURCE', '-Wno-nonnull', '-x', 'c', '-o', '/dev/null', '-', '-ldl', '-lpthread']
 DEVNULL = open(os.devnull, 'w')
 
 def memoize(f):
@@ -89,12 +89,46 @@ def has_memfd():
 		int main(void) { return syscall(__NR_memfd_create, "crux", 0); }
 	""")
 
+def has_epoll_pwait2():
+	return has_epoll() and compiles("""
+		#include <unistd.h>
+		#include <sys/syscall.h>
+		#include <linux/time_types.h>
+		int main(void) {
+			struct __kernel_timespec ts = { 0, 0 };
+			return syscall(__NR_epoll_pwait2, -1, 0, 1, &ts, 0, 0);
+		}
+	""")
+
 def has_vm_map():
 	return has_function("vm_map", 11, "mach/mach.h", "mach/vm_map.h")
 
 def has_shm_open():
 	return has_function("shm_open", 5, "sys/mman.h", "fcntl.h")
 
+def has_io_uring():
+	return has_epoll() and compiles("""
+		#include <unistd.h>
+		#include <sys/syscall.h>
+		#include <linux/io_uring.h>
+		int main(void) {
+			struct io_uring_params p = { .features = IORING_FEAT_FAST_POLL };
+			return syscall(__NR_io_uring_setup, IORING_OP_RECV + IORING_OP_LINK_TIMEOUT, &p);
+		}
+	""")
+
+def has_affinity():
+	return compiles("""
+		#include <pthread.h>
+		#include <sched.h>
+		int main(void) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			sched_getaffinity(0, sizeof(set), &set);
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		}
+	""")
+
 print(("""
 #if !defined(HAS_X86_64) && !defined(HAS_X86_32) && !defined(HAS_ARM_64) && !defined(HAS_ARM_32)
 # if defined (__aarch64__)
@@ -118,6 +152,7 @@ if has_mach_time():     print_flag("MACH_TIME")
 if has_dladdr():        print_flag("DLADDR")
 if has_kqueue():        print_flag("KQUEUE")
 if has_epoll():         print_flag("EPOLL")
+if has_epoll_pwait2():  print_flag("EPOLL_PWAIT2")
 if has_pipe2():         print_flag("PIPE2")
 if has_getrandom():     print_flag("GETRANDOM")
 if has_mremap4():       print_flag("MREMAP4")
@@ -125,4 +160,6 @@ elif has_mremap5():     print_flag("MREMAP5")
 if has_vm_map():        print_flag("VM_MAP")
 if has_memfd():         print_flag("MEMFD")
 if has_shm_open():      print_flag("SHM_OPEN")
+if has_affinity():      print_flag("AFFINITY")
+if has_io_uring():      print_flag("IO_URING")
 
@@ -0,0 +1,177 @@
+#ifndef CRUX_POLL_H
+#define CRUX_POLL_H
+
+#include "def.h"
+#include "clock.h"
+
+#include <signal.h>
+
+enum xpoll_type
+{
+	XPOLL_NONE  = 0,
+	XPOLL_IN    = 1<<0,  /** Type for file descriptor readability */
+	XPOLL_OUT   = 1<<1,  /** Type for file descriptor writeability */
+	XPOLL_SIG   = 1<<2,  /** Type for signal readyness */
+	XPOLL_ERR   = 1<<16, /** Flag to indicate an error with the event */
+	XPOLL_EOF   = 1<<17, /** Flag to indicate an end-of-file state */
+	XPOLL_EXCL  = 1<<18, /** Flag to wake only one of the polls sharing a descriptor */
+	XPOLL_INOUT = (XPOLL_IN|XPOLL_OUT),
+	XPOLL_ANY   = (XPOLL_INOUT|XPOLL_SIG),
+};
+
+#define XPOLL_BATCH 64       /** Default number of events read from the kernel */
+#define XPOLL_BATCH_MAX 4096 /** Largest number of events read from the kernel */
+
+#define XPOLL_TYPE(n)  (int)((n) & 0xFFFF)
+#define XPOLL_ISERR(n) (!!((n) & XPOLL_ERR))
+#define XPOLL_ISEOF(n) (!!((n) & XPOLL_EOF))
+
+#define XEVENT_TYPE(ev)  XPOLL_TYPE((ev)->type)
+#define XEVENT_ISERR(ev) XPOLL_ISERR((ev)->type)
+#define XEVENT_ISEOF(ev) XPOLL_ISEOF((ev)->type)
+
+/**
+ * @brief  Opaque poll type
+ */
+struct xpoll;
+
+/**
+ * @brief  Transparent event type
+ */
+struct xevent {
+	int id;
+	int type;
+	int errcode;
+};
+
+/**
+ * @brief  Allocates and initializes a new poll
+ *
+ * @param[out]  pollp   indirect poll object pointer to own the new poll
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-EMFILE`: the per-process descriptor table is full
+ *   `-ENFILE`: the system file table is full
+ *   `-ENOMEM`: insufficient memory was available
+ */
+XEXTERN int
+xpoll_new(struct xpoll **pollp);
+
+/**
+ * @brief  Finalizes and deallocates an idirectly referenced poll object
+ * 
+ * The objected pointed to by `*pollp` may be NULL, but `pollp` must point
+ * to a valid address. The `*pollp` address will be set to NULL.
+ *
+ * @param  pollp  indirect poll object pointer
+ */
+XEXTERN void
+xpoll_free(struct xpoll **pollp);
+
+/**
+ * @brief  Performs control operations on the poll
+ *
+ * This is used to add and remove events of interest from the poll.
+ *
+ * @param  poll     poll pointer
+ * @param  id       file descriptor or signal number
+ * @param  oldtype  current event type (XPOLL_IN, XPOLL_OUT, or XPOLL_SIG)
+ * @param  newtype  desired event type (XPOLL_IN, XPOLL_OUT, or XPOLL_SIG)
+ * @return  0 on sucess, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: the operation, type, or signal number are invalid
+ *   `-EBADF`: the specified descriptor is invalid
+ *   `-EEXIST`: the event already exists
+ *   `-ENOENT`: the event could not be found to be modified or deleted
+ *   `-ENOMEM`: no memory was available to register the event
+ */
+XEXTERN int
+xpoll_ctl(struct xpoll *poll, int id, int oldtype, int newtype);
+
+XEXTERN int
+xpoll_wake(struct xpoll *poll);
+
+/**
+ * @brief  Reads the next event from the poller
+ *
+ * The poller maintains an internal event list. When empty, more events will
+ * be requested from the kernel.
+ *
+ * @param  poll  poll pointer
+ * @param  ms    milliseconds until timeout, or -1 for infinite
+ * @param[out]  ev  event information if successful
+ * @return  1 on sucess, 0 on timeout, -errno on error
+ */
+XEXTERN int
+xpoll_wait(struct xpoll *poll, int64_t ms, struct xevent *ev);
+
+/**
+ * @brief  Reads a batch of events from the poller
+ *
+ * This waits just as `xpoll_wait` does for the first event and then fills
+ * the rest of `evs` from events the kernel has already returned, so no more
+ * than one system call is made. A signal or wake event in the batch may be
+ * followed by more events. Events already returned are not withdrawn if
+ * their descriptor is removed with `xpoll_ctl` afterwards.
+ *
+ * @param  poll  poll pointer
+ * @param  ms    milliseconds until timeout, or -1 for infinite
+ * @param[out]  evs  array of at least `n` events
+ * @param  n     maximum number of events to read
+ * @return  number of events, 0 on timeout, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: `n` is less than 1
+ */
+XEXTERN int
+xpoll_waitv(struct xpoll *poll, int64_t ms, struct xevent *evs, int n);
+
+/**
+ * @brief  Reads a batch of events with a timeout in nanoseconds
+ *
+ * This is `xpoll_waitv` for timeouts finer than a millisecond. Where the
+ * kernel can't wait with that resolution, the timeout is rounded up to the
+ * next millisecond so it never ends early.
+ *
+ * @param  poll  poll pointer
+ * @param  ns    nanoseconds until timeout, or -1 for infinite
+ * @param[out]  evs  array of at least `n` events
+ * @param  n     maximum number of events to read
+ * @return  number of events, 0 on timeout, -errno on error
+ */
+XEXTERN int
+xpoll_waitv_ns(struct xpoll *poll, int64_t ns, struct xevent *evs, int n);
+
+/**
+ * @brief  Sets the number of events requested from the kernel per wait
+ *
+ * The default is `XPOLL_BATCH`. Larger batches let a busy poll collect more
+ * ready descriptors per system call at the cost of memory for the buffer.
+ *
+ * @param  poll  poll pointer
+ * @param  n     number of events, up to `XPOLL_BATCH_MAX`
+ * @return  0 on sucess, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: `n` is 0 or greater than `XPOLL_BATCH_MAX`
+ *   `-EBUSY`: more events than `n` are still buffered
+ *   `-ENOMEM`: insufficient memory was available
+ */
+XEXTERN int
+xpoll_set_batch(struct xpoll *poll, unsigned n);
+
+/**
+ * @brief  Gets the monotonic clock associated with the poll
+ *
+ * This clock gets updated just prior to yielding an event from `xpoll_wait`.
+ *
+ * @param  poll  poll pointer
+ * @return  clock pointer
+ */
+XEXTERN const struct timespec *
+xpoll_clock(const struct xpoll *poll);
+
+#endif
+
@@ -0,0 +1,17 @@
+#ifndef CRUX_RANGE_H
+#define CRUX_RANGE_H
+
+#include <stdint.h>
+
+struct xrange8
+{
+	uint8_t off, len;
+};
+
+struct xrange16
+{
+	uint16_t off, len;
+};
+
+#endif
+
@@ -0,0 +1,10 @@
+#ifndef CRUX_READLINE_H
+#define CRUX_READLINE_H
+
+#include "def.h"
+
+XEXTERN char *
+xreadline(const char *prompt);
+
+#endif
+
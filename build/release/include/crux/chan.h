@@ -0,0 +1,133 @@
+#ifndef CRUX_CHAN_H
+#define CRUX_CHAN_H
+
+#include "def.h"
+#include "value.h"
+
+/**
+ * @brief  Opaque type for a channel between tasks on a hub
+ *
+ * A channel carries fixed-size messages from sending tasks to receiving
+ * tasks. Messages are copied directly between tasks when the other side is
+ * already waiting, and a channel with a capacity buffers up to that many
+ * messages before senders block. A channel with no capacity is unbuffered:
+ * every send waits until a receiver takes the message.
+ *
+ * Blocked tasks are parked on the channel and resumed through the hub's
+ * immediate list, so no system calls are made. A channel is bound to the hub
+ * of the first task that uses it, and tasks running on another hub receive
+ * `-EXDEV`. Functions may be called outside of a task as long as they do not
+ * need to wait.
+ */
+struct xchan;
+
+/**
+ * @brief  Allocates a new channel
+ *
+ * @param[out]  chp    indirect channel object pointer to own the new channel
+ * @param  msgsz  size in bytes of each message
+ * @param  cap    number of messages buffered before senders block
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: the message size is 0
+ *   `-ENOMEM`: the system is out of memory
+ */
+XEXTERN int
+xchan_new(struct xchan **chp, size_t msgsz, size_t cap);
+
+/**
+ * @brief  Closes and deallocates an indirectly referenced channel
+ *
+ * Any tasks waiting on the channel are resumed with `-EPIPE`. The object
+ * pointed to by `*chp` may be NULL, but `chp` must point to a valid address.
+ * The `*chp` address will be set to NULL.
+ *
+ * @param  chp  indirect channel object pointer
+ */
+XEXTERN void
+xchan_free(struct xchan **chp);
+
+/**
+ * @brief  Closes the channel for sending
+ *
+ * Waiting senders are resumed with `-EPIPE`. Buffered messages may still be
+ * received, after which receivers get `-EPIPE` as well.
+ *
+ * @param  ch  channel pointer
+ */
+XEXTERN void
+xchan_close(struct xchan *ch);
+
+/**
+ * @brief  Sends a message, waiting for room if needed
+ *
+ * @param  ch         channel pointer
+ * @param  msg        message of the channel's message size
+ * @param  timeoutms  timeout in milliseconds or `XTIMEOUT_NONE`
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-EPIPE`: the channel is closed
+ *   `-ETIMEDOUT`: no receiver took the message in time
+ *   `-EXDEV`: the channel belongs to another hub
+ *   `-EPERM`: waiting is required outside of a task
+ */
+XEXTERN int
+xchan_send(struct xchan *ch, const void *msg, int timeoutms);
+
+/**
+ * @brief  Receives a message, waiting for one if needed
+ *
+ * @param  ch         channel pointer
+ * @param[out]  msg        buffer of the channel's message size
+ * @param  timeoutms  timeout in milliseconds or `XTIMEOUT_NONE`
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-EPIPE`: the channel is closed and empty
+ *   `-ETIMEDOUT`: no message arrived in time
+ *   `-EXDEV`: the channel belongs to another hub
+ *   `-EPERM`: waiting is required outside of a task
+ */
+XEXTERN int
+xchan_recv(struct xchan *ch, void *msg, int timeoutms);
+
+/**
+ * @brief  Sends a value on a channel created with `sizeof(union xvalue)`
+ */
+XSTATIC inline int
+xchan_sendv(struct xchan *ch, union xvalue val, int timeoutms)
+{
+	return xchan_send(ch, &val, timeoutms);
+}
+
+/**
+ * @brief  Receives a value from a channel created with `sizeof(union xvalue)`
+ */
+XSTATIC inline int
+xchan_recvv(struct xchan *ch, union xvalue *val, int timeoutms)
+{
+	return xchan_recv(ch, val, timeoutms);
+}
+
+/**
+ * @brief  Gets the number of buffered messages
+ *
+ * @param  ch  channel pointer
+ * @return  number of messages
+ */
+XEXTERN size_t
+xchan_count(const struct xchan *ch);
+
+/**
+ * @brief  Gets the buffer capacity
+ *
+ * @param  ch  channel pointer
+ * @return  number of messages, 0 for an unbuffered channel
+ */
+XEXTERN size_t
+xchan_cap(const struct xchan *ch);
+
+#endif
+
@@ -0,0 +1,108 @@
+#ifndef CRUX_GROUP_H
+#define CRUX_GROUP_H
+
+#include "def.h"
+#include "value.h"
+
+struct xhub;
+
+/**
+ * @brief  Opaque type for a group of tasks spawned together on a hub
+ *
+ * A group runs each child as a hub task and lets a task wait for all of them
+ * to finish. Children return 0 or -errno, and the first child to fail cancels
+ * the others with `xtask_cancel` and ends the wait with its error. Releasing
+ * the group with `xgroup_free` cancels the children that are still running,
+ * so none of them outlive the scope that owned the group.
+ *
+ * Waiting parks the task on the group and the last child resumes it through
+ * the hub's immediate list, so joining makes no allocations or system calls.
+ * Children are always spawned on the group's hub, and the group may only be
+ * used by tasks on that hub or before it runs.
+ */
+struct xgroup;
+
+/**
+ * @brief  Allocates a new group for tasks on a hub
+ *
+ * @param[out]  grpp  indirect group object pointer to own the new group
+ * @param  hub   hub to spawn the children on
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-ENOMEM`: the system is out of memory
+ */
+XEXTERN int
+xgroup_new(struct xgroup **grpp, struct xhub *hub);
+
+/**
+ * @brief  Cancels the remaining children and releases the group
+ *
+ * Children that are still running are cancelled and the group is deallocated
+ * once the last of them ends. Tasks still waiting on the group are resumed
+ * with `-ECANCELED`. The object pointed to by `*grpp` may be NULL, but `grpp`
+ * must point to a valid address. The `*grpp` address will be set to NULL.
+ *
+ * @param  grpp  indirect group object pointer
+ */
+XEXTERN void
+xgroup_free(struct xgroup **grpp);
+
+#define xgroup_spawn(grp, fn, val) \
+	xgroup_spawnf(grp, __FILE__, __LINE__, fn, val)
+
+/**
+ * @brief  Spawns a child task into the group
+ *
+ * The child inherits the deadline of the calling task.
+ *
+ * @param  grp   group pointer
+ * @param  file  spawn site file name
+ * @param  line  spawn site line number
+ * @param  fn    child function returning 0 or -errno
+ * @param  val   value passed to `fn`
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-ECANCELED`: a child has already failed
+ *   `-EXDEV`: called from a task on another hub
+ *   `-ENOMEM`: the system is out of memory
+ */
+XEXTERN int
+xgroup_spawnf(struct xgroup *grp, const char *file, int line,
+		int (*fn)(struct xhub *, union xvalue), union xvalue val);
+
+/**
+ * @brief  Waits for every child to finish or for the first to fail
+ *
+ * @param  grp        group pointer
+ * @param  timeoutms  timeout in milliseconds or `XTIMEOUT_NONE`
+ * @return  0 when all children returned 0, or the first error returned
+ *
+ * Errors:
+ *   `-ETIMEDOUT`: children were still running at the timeout
+ *   `-ECANCELED`: the waiting task or the group was cancelled
+ *   `-EPERM`: waiting is required outside of a task
+ */
+XEXTERN int
+xgroup_wait(struct xgroup *grp, int timeoutms);
+
+/**
+ * @brief  Cancels every child that is still running
+ *
+ * @param  grp  group pointer
+ */
+XEXTERN void
+xgroup_cancel(struct xgroup *grp);
+
+/**
+ * @brief  Gets the number of children still running
+ *
+ * @param  grp  group pointer
+ * @return  number of children
+ */
+XEXTERN unsigned
+xgroup_count(const struct xgroup *grp);
+
+#endif
+
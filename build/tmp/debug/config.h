@@ -0,0 +1,61 @@
+#if !defined(HAS_X86_64) && !defined(HAS_X86_32) && !defined(HAS_ARM_64) && !defined(HAS_ARM_32)
+# if defined (__aarch64__)
+#  define HAS_ARM_64 1
+# elif defined (__arm__)
+#  define HAS_ARM_32 1
+# elif defined (__amd64__) || defined (__x86_64__) || defined (_M_X64) || defined (_M_AMD64)
+#  define HAS_X86_64 1
+# elif defined (__i386__) || defined (_M_IX86) || defined (_X86_)
+#  define HAS_X86_32 1
+# else
+#  define HAS_X86_64 1
+# endif
+#endif
+#ifndef HAS_SOCK_FLAGS
+# define HAS_SOCK_FLAGS 1
+#endif
+#ifndef HAS_ACCEPT4
+# define HAS_ACCEPT4 1
+#endif
+#ifndef HAS_CLOCK_GETTIME
+# define HAS_CLOCK_GETTIME 1
+#endif
+#ifndef HAS_DLADDR
+# define HAS_DLADDR 1
+#endif
+#ifndef HAS_EPOLL
+# define HAS_EPOLL 1
+#endif
+#ifndef HAS_EPOLL_PWAIT2
+# define HAS_EPOLL_PWAIT2 1
+#endif
+#ifndef HAS_PIPE2
+# define HAS_PIPE2 1
+#endif
+#ifndef HAS_GETRANDOM
+# define HAS_GETRANDOM 1
+#endif
+#ifndef HAS_MREMAP4
+# define HAS_MREMAP4 1
+#endif
+#ifndef HAS_MEMFD
+# define HAS_MEMFD 1
+#endif
+#ifndef HAS_AFFINITY
+# define HAS_AFFINITY 1
+#endif
+#ifndef HAS_IO_URING
+# define HAS_IO_URING 1
+#endif
+#ifndef HAS_EXECINFO
+# define HAS_EXECINFO 1
+#endif
+#define WITH_POLL 1
+#define WITH_TASK 1
+#define WITH_HUB 1
+#define WITH_FILTER 0
+#define WITH_HTTP 1
+#define WITH_NET 1
+#define WITH_DNS 1
+#define WITH_RESOLV 1
+#define WITH_READLINE 1
@@ -14,7 +14,82 @@
 #define XTIMEOUT_NONE -1
 #define XTIMEOUT_DETACH INT_MIN
 
+#define XHUB_BATCH_BUCKETS 16
+#define XHUB_TIME_BUCKETS 32
+#define XHUB_IO_BUDGET 64
+
+#define XHUB_PRIO_HIGH 0
+#define XHUB_PRIO_NORMAL 1
+#define XHUB_PRIO_LOW 2
+#define XHUB_PRIOS 3
+
 struct xhub;
+struct xhub_pool;
+struct xchan;
+
+#define XSELECT_SEND (1<<8) /** Type for sending on a channel */
+#define XSELECT_RECV (1<<9) /** Type for receiving from a channel */
+
+/**
+ * @brief  One operation for `xselect`
+ *
+ * The `type` is one of `XPOLL_IN`, `XPOLL_OUT`, or `XPOLL_SIG` with `id` as
+ * the file descriptor or signal number, or `XSELECT_SEND` or `XSELECT_RECV`
+ * with `chan` and `msg`. The `rc` field is set for the operation that fired
+ * to the value `xwait`, `xsignal`, or `xchan_send`/`xchan_recv` would return.
+ */
+struct xselect {
+	int type;
+	int id;
+	struct xchan *chan;
+	void *msg;
+	int rc;
+};
+
+/**
+ * @brief  Saved deadline of the enclosing scope for `xscope_exit`
+ */
+struct xscope {
+	int64_t prev;
+};
+
+struct xhub_stats {
+	uint64_t iterations;                   /** batched loop iterations */
+	uint64_t dispatched;                   /** events and timers dispatched */
+	unsigned batch_max;                    /** largest single batch */
+	uint64_t batch[XHUB_BATCH_BUCKETS];    /** batch n counts sizes in [2^n, 2^(n+1)) */
+	uint64_t posted;                       /** tasks received through `xhub_post` */
+	uint64_t post_drains;                  /** passes that took at least one post */
+	uint64_t reads_saved;                  /** readiness-mode reads that waited without an EAGAIN first */
+	uint64_t forced_yields;                /** tasks requeued for using up their I/O budget */
+	uint64_t spin_hits;                    /** busy-poll spins that found an event */
+	uint64_t spin_misses;                  /** busy-poll spins that went on to block */
+	uint64_t resumed;                      /** resumes timed with `xhub_account` */
+	uint64_t wait_ns, wait_max;            /** time from runnable to resumed */
+	uint64_t wait[XHUB_TIME_BUCKETS];      /** wait n counts waits in [2^n, 2^(n+1)) ns */
+	uint64_t run_ns, run_max;              /** time from resumed to yielded */
+	uint64_t run[XHUB_TIME_BUCKETS];       /** run n counts runs in [2^n, 2^(n+1)) ns */
+};
+
+struct xhub_site {
+	const char *file;                      /** spawn site of the tasks */
+	int line;
+	uint64_t tasks;                        /** tasks that have finished */
+	uint64_t cpu_ns, cpu_max;              /** time the tasks ran in total */
+	uint64_t cpu[XHUB_TIME_BUCKETS];       /** cpu n counts tasks that ran [2^n, 2^(n+1)) ns */
+};
+
+struct xhub_offload_stats {
+	unsigned workers;                      /** worker threads started */
+	unsigned busy;                         /** workers running a call now */
+	unsigned queued;                       /** calls waiting for a worker */
+	unsigned queued_max;                   /** deepest the queue has been */
+	uint64_t submitted;                    /** calls accepted */
+	uint64_t completed;                    /** calls finished by a worker */
+	uint64_t rejected;                     /** calls refused with a full queue */
+	uint64_t busy_ns;                      /** time workers spent in calls */
+	uint64_t alive_ns;                     /** combined lifetime of all workers */
+};
 
 XEXTERN int
 xhub_new(struct xhub **hubp);
@@ -31,12 +106,71 @@ xhub_wake(struct xhub *hub);
 XEXTERN void
 xhub_stop(struct xhub *hub);
 
+XEXTERN void
+xhub_set_batch(struct xhub *hub, unsigned budget);
+
+XEXTERN int
+xhub_set_prio_weight(struct xhub *hub, int prio, unsigned weight);
+
+XEXTERN void
+xhub_set_io_budget(struct xhub *hub, unsigned calls, unsigned usec);
+
+XEXTERN void
+xhub_set_busy_poll(struct xhub *hub, unsigned usec, bool sockopt);
+
+XEXTERN void
+xhub_set_ring(struct xhub *hub, bool enable);
+
+XEXTERN void
+xhub_stats(const struct xhub *hub, struct xhub_stats *stats);
+
+XEXTERN void
+xhub_account(struct xhub *hub, bool enable);
+
+XEXTERN int
+xhub_sites(const struct xhub *hub, struct xhub_site *sites, int nsites);
+
+XEXTERN struct xmgr *
+xhub_mgr(struct xhub *hub);
+
 XEXTERN void
 xhub_remove_io(struct xhub *hub, int fd);
 
 XEXTERN void
 xhub_print(struct xhub *hub, FILE *out);
 
+XEXTERN int
+xhub_pool_new(struct xhub_pool **poolp, int nhubs);
+
+XEXTERN void
+xhub_pool_free(struct xhub_pool **poolp);
+
+XEXTERN int
+xhub_pool_run(struct xhub_pool *pool);
+
+XEXTERN void
+xhub_pool_stop(struct xhub_pool *pool);
+
+XEXTERN int
+xhub_pool_size(const struct xhub_pool *pool);
+
+XEXTERN struct xhub *
+xhub_pool_get(struct xhub_pool *pool, int idx);
+
+#define xhub_pool_spawn(pool, idx, fn, val) \
+	xhub_pool_spawnf(pool, idx, __FILE__, __LINE__, fn, val)
+
+XEXTERN int
+xhub_pool_spawnf(struct xhub_pool *pool, int idx, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val);
+
+#define xhub_post(hub, fn, val) \
+	xhub_postf(hub, __FILE__, __LINE__, fn, val)
+
+XEXTERN int
+xhub_postf(struct xhub *hub, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val);
+
 #define xspawn(hub, fn, val) \
 	xspawnf(hub, __FILE__, __LINE__, fn, val)
 
@@ -44,6 +178,13 @@ XEXTERN int
 xspawnf(struct xhub *hub, const char *file, int line,
 		void (*fn)(struct xhub *, union xvalue), union xvalue val);
 
+#define xspawn_prio(hub, prio, fn, val) \
+	xspawnf_prio(hub, prio, __FILE__, __LINE__, fn, val)
+
+XEXTERN int
+xspawnf_prio(struct xhub *hub, int prio, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val);
+
 #if defined(__BLOCKS__)
 
 XEXTERN int
@@ -57,15 +198,51 @@ xexit(int ec);
 XEXTERN void
 xabort(void);
 
+XEXTERN int
+xtask_cancel(struct xtask *t);
+
+XEXTERN int
+xscope_enter(struct xscope *scope, int timeoutms);
+
+XEXTERN int
+xscope_enter_ns(struct xscope *scope, int64_t timeoutns);
+
+XEXTERN void
+xscope_exit(const struct xscope *scope);
+
+XEXTERN int
+xscope_remaining(void);
+
 XEXTERN const struct timespec *
 xclock(void);
 
+XEXTERN uint64_t
+xcputime(void);
+
 XEXTERN int
 xwait(int fd, int polltype, int timeoutms);
 
+XEXTERN int
+xwait_ns(int fd, int polltype, int64_t timeoutns);
+
+XEXTERN int
+xselect(struct xselect *ops, int nops, int timeoutms);
+
+XEXTERN int
+xhub_offload(int (*fn)(void *), void *arg, int timeoutms);
+
+XEXTERN int
+xhub_offload_config(unsigned workers, unsigned queue);
+
+XEXTERN void
+xhub_offload_stats(struct xhub_offload_stats *stats);
+
 XEXTERN int
 xsleep(unsigned ms);
 
+XEXTERN int
+xsleep_ns(uint64_t ns);
+
 XEXTERN int
 xsignal(int signum, int timeoutms);
 
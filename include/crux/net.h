@@ -52,5 +52,54 @@ xsockaddr(int fd, union xaddr *addr);
 XEXTERN int
 xpeeraddr(int fd, union xaddr *addr);
 
+/**
+ * @brief  Opaque type for one stream service address accepted on by many hubs
+ *
+ * Each shard is meant to be accepted on by a single hub, such as the hub
+ * with the same index in a `struct xhub_pool`. Where `SO_REUSEPORT` is
+ * supported, every shard has its own listening socket bound to the address
+ * and the kernel spreads new connections across them. Otherwise, including
+ * for UNIX sockets, the shards share one socket that each hub polls with
+ * `XPOLL_EXCL`, so a new connection wakes only one of them.
+ */
+struct xlistener;
+
+/**
+ * @brief  Binds a stream listener with one shard per hub
+ *
+ * The address is parsed as with `xbind` and `addr` receives the bound
+ * address, including any ephemeral port chosen by the first shard.
+ *
+ * @return  0 on success, -errno on error
+ */
+XEXTERN int
+xlisten_sharded(struct xlistener **lp, const char *net, int flags, int nshards,
+		union xaddr *addr);
+
+XEXTERN void
+xlistener_free(struct xlistener **lp);
+
+XEXTERN int
+xlistener_shards(const struct xlistener *l);
+
+XEXTERN bool
+xlistener_is_shared(const struct xlistener *l);
+
+XEXTERN int
+xlistener_fd(const struct xlistener *l, int shard);
+
+/**
+ * @brief  Accepts a connection on a shard, as with `xaccept`
+ */
+XEXTERN int
+xlistener_accept(struct xlistener *l, int shard, int flags, int timeoutms,
+		union xaddr *addr);
+
+/**
+ * @brief  Gets the number of connections accepted on a shard
+ */
+XEXTERN uint64_t
+xlistener_accepted(const struct xlistener *l, int shard);
+
 #endif
 
@@ -14,10 +14,14 @@ enum xpoll_type
 	XPOLL_SIG   = 1<<2,  /** Type for signal readyness */
 	XPOLL_ERR   = 1<<16, /** Flag to indicate an error with the event */
 	XPOLL_EOF   = 1<<17, /** Flag to indicate an end-of-file state */
+	XPOLL_EXCL  = 1<<18, /** Flag to wake only one of the polls sharing a descriptor */
 	XPOLL_INOUT = (XPOLL_IN|XPOLL_OUT),
 	XPOLL_ANY   = (XPOLL_INOUT|XPOLL_SIG),
 };
 
+#define XPOLL_BATCH 64       /** Default number of events read from the kernel */
+#define XPOLL_BATCH_MAX 4096 /** Largest number of events read from the kernel */
+
 #define XPOLL_TYPE(n)  (int)((n) & 0xFFFF)
 #define XPOLL_ISERR(n) (!!((n) & XPOLL_ERR))
 #define XPOLL_ISEOF(n) (!!((n) & XPOLL_EOF))
@@ -103,6 +107,61 @@ xpoll_wake(struct xpoll *poll);
 XEXTERN int
 xpoll_wait(struct xpoll *poll, int64_t ms, struct xevent *ev);
 
+/**
+ * @brief  Reads a batch of events from the poller
+ *
+ * This waits just as `xpoll_wait` does for the first event and then fills
+ * the rest of `evs` from events the kernel has already returned, so no more
+ * than one system call is made. A signal or wake event in the batch may be
+ * followed by more events. Events already returned are not withdrawn if
+ * their descriptor is removed with `xpoll_ctl` afterwards.
+ *
+ * @param  poll  poll pointer
+ * @param  ms    milliseconds until timeout, or -1 for infinite
+ * @param[out]  evs  array of at least `n` events
+ * @param  n     maximum number of events to read
+ * @return  number of events, 0 on timeout, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: `n` is less than 1
+ */
+XEXTERN int
+xpoll_waitv(struct xpoll *poll, int64_t ms, struct xevent *evs, int n);
+
+/**
+ * @brief  Reads a batch of events with a timeout in nanoseconds
+ *
+ * This is `xpoll_waitv` for timeouts finer than a millisecond. Where the
+ * kernel can't wait with that resolution, the timeout is rounded up to the
+ * next millisecond so it never ends early.
+ *
+ * @param  poll  poll pointer
+ * @param  ns    nanoseconds until timeout, or -1 for infinite
+ * @param[out]  evs  array of at least `n` events
+ * @param  n     maximum number of events to read
+ * @return  number of events, 0 on timeout, -errno on error
+ */
+XEXTERN int
+xpoll_waitv_ns(struct xpoll *poll, int64_t ns, struct xevent *evs, int n);
+
+/**
+ * @brief  Sets the number of events requested from the kernel per wait
+ *
+ * The default is `XPOLL_BATCH`. Larger batches let a busy poll collect more
+ * ready descriptors per system call at the cost of memory for the buffer.
+ *
+ * @param  poll  poll pointer
+ * @param  n     number of events, up to `XPOLL_BATCH_MAX`
+ * @return  0 on sucess, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: `n` is 0 or greater than `XPOLL_BATCH_MAX`
+ *   `-EBUSY`: more events than `n` are still buffered
+ *   `-ENOMEM`: insufficient memory was available
+ */
+XEXTERN int
+xpoll_set_batch(struct xpoll *poll, unsigned n);
+
 /**
  * @brief  Gets the monotonic clock associated with the poll
  *
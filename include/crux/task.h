@@ -8,6 +8,9 @@
 
 #define XTASK_FPROTECT   (UINT32_C(1) << 0)
 #define XTASK_FENTRY     (UINT32_C(1) << 1)
+#define XTASK_FSHARED    (UINT32_C(1) << 2)
+#define XTASK_FPROFILE   (UINT32_C(1) << 3)
+#define XTASK_FHUGE      (UINT32_C(1) << 4)
 
 #define XTASK_FDEFAULT (XTASK_FPROTECT)
 #define XTASK_FDEBUG (XTASK_FPROTECT|XTASK_FENTRY)
@@ -18,6 +21,11 @@
 
 #define XTASK_TLS_MAX 16384
 
+#define XMGR_FREE_LOW 64
+#define XMGR_FREE_HIGH 1024
+#define XMGR_SHARED_STACKS 4
+#define XMGR_SLAB_TASKS 16
+
 
 struct xmgr;
 
@@ -30,6 +38,18 @@ xmgr_free(struct xmgr **mgrp);
 XEXTERN struct xmgr *
 xmgr_self(void);
 
+XEXTERN int
+xmgr_watermarks(struct xmgr *mgr, unsigned low, unsigned high);
+
+XEXTERN int
+xmgr_prewarm(struct xmgr *mgr, unsigned n);
+
+XEXTERN int
+xmgr_profile(struct xmgr *mgr, bool enable);
+
+XEXTERN void
+xmgr_print(const struct xmgr *mgr, FILE *out);
+
 
 struct xtask;
 
@@ -15,11 +15,49 @@ xvm_reallocsub(void **const ptr, size_t oldsz, size_t newsz, size_t off, size_t
 XEXTERN int
 xvm_dealloc(void *ptr, size_t sz);
 
+/**
+ * @brief  Maps a ring of `sz` bytes followed by a mirror of itself
+ *
+ * Rings of up to 16 pages are taken from a process-wide pool of released
+ * rings of the same size when one is available, so their contents are
+ * undefined.
+ */
 XEXTERN int
 xvm_alloc_ring(void **const ptr, size_t sz);
 
+/**
+ * @brief  Releases a ring from `xvm_alloc_ring`, keeping it pooled if possible
+ */
 XEXTERN int
 xvm_dealloc_ring(void *ptr, size_t sz);
 
+/**
+ * @brief  Configures the ring pool
+ *
+ * Each ring size keeps at most `max` released rings, and a size unused for
+ * `idlems` is unmapped by the next ring allocation or release. Nothing else
+ * checks the idle time, so a process that stops using rings keeps its pool
+ * until it calls `xvm_ring_trim`. Lowering `max` unmaps the pooled rings
+ * beyond it right away, and a `max` of 0 disables pooling. The defaults
+ * are 32 rings and 1000ms. A forked child starts with an empty pool.
+ *
+ * @param  max     rings kept per size
+ * @param  idlems  milliseconds before an unused size is trimmed
+ * @return  0 on success, -errno on error
+ *
+ * Errors:
+ *   `-EINVAL`: the idle time is less than 1
+ */
+XEXTERN int
+xvm_ring_config(unsigned max, int idlems);
+
+/**
+ * @brief  Unmaps every ring held by the pool
+ *
+ * @return  number of rings unmapped
+ */
+XEXTERN unsigned
+xvm_ring_trim(void);
+
 #endif
 
@@ -0,0 +1,199 @@
+#include "hub.h"
+#include "chan.h"
+#include "../include/crux/err.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct xchan {
+	struct xhub *hub;              /** hub of the first task to use it */
+	size_t msgsz;
+	size_t cap;
+	size_t head, count;            /** ring of buffered messages */
+	bool closed;
+	struct xlist senders;          /** parked with their message in `data` */
+	struct xlist receivers;        /** parked with their buffer in `data` */
+	uint8_t buf[];
+};
+
+#define MSG(ch, n) ((ch)->buf + (((ch)->head + (n)) % (ch)->cap) * (ch)->msgsz)
+
+static int
+bind_hub(struct xchan *ch)
+{
+	struct xhub *hub = xhub_current();
+	if (hub == NULL) { return 0; }
+	if (ch->hub == NULL) { ch->hub = hub; }
+	return ch->hub == hub ? 0 : xerr_sys(EXDEV);
+}
+
+static struct xhub_wait *
+first_waiter(struct xlist *list)
+{
+	struct xlist *elem = xlist_first(list, X_ASCENDING);
+	return elem ? xcontainer(elem, struct xhub_wait, link) : NULL;
+}
+
+static void
+wake_all(struct xlist *list, int rc)
+{
+	struct xhub_wait *w;
+	while ((w = first_waiter(list))) {
+		xhub_unpark(w, rc);
+	}
+}
+
+int
+xchan_new(struct xchan **chp, size_t msgsz, size_t cap)
+{
+	assert(chp != NULL);
+
+	if (msgsz == 0) {
+		return xerr_sys(EINVAL);
+	}
+
+	struct xchan *ch = malloc(sizeof(*ch) + msgsz*cap);
+	if (ch == NULL) {
+		return xerrno;
+	}
+
+	ch->hub = NULL;
+	ch->msgsz = msgsz;
+	ch->cap = cap;
+	ch->head = 0;
+	ch->count = 0;
+	ch->closed = false;
+	xlist_init(&ch->senders);
+	xlist_init(&ch->receivers);
+
+	*chp = ch;
+	return 0;
+}
+
+void
+xchan_free(struct xchan **chp)
+{
+	assert(chp != NULL);
+
+	struct xchan *ch = *chp;
+	if (ch != NULL) {
+		*chp = NULL;
+		xchan_close(ch);
+		free(ch);
+	}
+}
+
+void
+xchan_close(struct xchan *ch)
+{
+	assert(ch != NULL);
+
+	// receivers are only parked while the buffer is empty, so there is
+	// nothing left for them to receive
+	ch->closed = true;
+	wake_all(&ch->senders, xerr_sys(EPIPE));
+	wake_all(&ch->receivers, xerr_sys(EPIPE));
+}
+
+static int
+try_send(struct xchan *ch, const void *msg)
+{
+	if (ch->closed) { return xerr_sys(EPIPE); }
+
+	// hand the message straight to a waiting receiver
+	struct xhub_wait *w = first_waiter(&ch->receivers);
+	if (w) {
+		memcpy(w->data, msg, ch->msgsz);
+		xhub_unpark(w, 0);
+		return 0;
+	}
+
+	if (ch->count < ch->cap) {
+		memcpy(MSG(ch, ch->count), msg, ch->msgsz);
+		ch->count++;
+		return 0;
+	}
+
+	return xerr_sys(EAGAIN);
+}
+
+static int
+try_recv(struct xchan *ch, void *msg)
+{
+	struct xhub_wait *w = first_waiter(&ch->senders);
+
+	if (ch->count > 0) {
+		memcpy(msg, MSG(ch, 0), ch->msgsz);
+		ch->head = (ch->head + 1) % ch->cap;
+		ch->count--;
+		// the oldest blocked sender takes the free slot
+		if (w) {
+			memcpy(MSG(ch, ch->count), w->data, ch->msgsz);
+			ch->count++;
+			xhub_unpark(w, 0);
+		}
+		return 0;
+	}
+
+	if (w) {
+		memcpy(msg, w->data, ch->msgsz);
+		xhub_unpark(w, 0);
+		return 0;
+	}
+
+	return ch->closed ? xerr_sys(EPIPE) : xerr_sys(EAGAIN);
+}
+
+int
+xchan_try(struct xchan *ch, bool send, void *msg)
+{
+	assert(ch != NULL);
+	assert(msg != NULL);
+
+	int rc = bind_hub(ch);
+	if (rc < 0) { return rc; }
+	return send ? try_send(ch, msg) : try_recv(ch, msg);
+}
+
+struct xlist *
+xchan_waiters(struct xchan *ch, bool send)
+{
+	return send ? &ch->senders : &ch->receivers;
+}
+
+int
+xchan_send(struct xchan *ch, const void *msg, int timeoutms)
+{
+	int rc = xchan_try(ch, true, (void *)msg);
+	if (rc != xerr_sys(EAGAIN)) { return rc; }
+
+	// the receiver copies the message out of this stack frame
+	return xhub_park(&ch->senders, (void *)msg, timeoutms);
+}
+
+int
+xchan_recv(struct xchan *ch, void *msg, int timeoutms)
+{
+	int rc = xchan_try(ch, false, msg);
+	if (rc != xerr_sys(EAGAIN)) { return rc; }
+
+	return xhub_park(&ch->receivers, msg, timeoutms);
+}
+
+size_t
+xchan_count(const struct xchan *ch)
+{
+	assert(ch != NULL);
+
+	return ch->count;
+}
+
+size_t
+xchan_cap(const struct xchan *ch)
+{
+	assert(ch != NULL);
+
+	return ch->cap;
+}
+
@@ -0,0 +1,24 @@
+#include "../include/crux/chan.h"
+#include "../include/crux/list.h"
+
+/**
+ * @brief  Sends or receives a message only if it can complete without waiting
+ *
+ * @param  ch    channel pointer
+ * @param  send  true to send `msg`, false to receive into it
+ * @param  msg   message or buffer of the channel's message size
+ * @return  0 on success, `-EAGAIN` if the call would wait, or -errno
+ */
+XLOCAL int
+xchan_try(struct xchan *ch, bool send, void *msg);
+
+/**
+ * @brief  Gets the list that waiting senders or receivers are parked on
+ *
+ * @param  ch    channel pointer
+ * @param  send  true for the senders list
+ * @return  list of `struct xhub_wait` nodes
+ */
+XLOCAL struct xlist *
+xchan_waiters(struct xchan *ch, bool send);
+
@@ -8,6 +8,8 @@ struct xctx {
 	uintptr_t ecx;
 };
 
+#define XCTX_SP(ctx) ((ctx)->esp)
+
 void
 xctx_init(struct xctx *ctx, void *stack, size_t len,
 		uintptr_t ip, uintptr_t a1, uintptr_t a2)
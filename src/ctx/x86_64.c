@@ -11,6 +11,8 @@ struct xctx {
 	uintptr_t rsp;
 };
 
+#define XCTX_SP(ctx) ((ctx)->rsp)
+
 void
 xctx_init(struct xctx *ctx, void *stack, size_t len,
 		uintptr_t ip, uintptr_t a1, uintptr_t a2)
@@ -0,0 +1,176 @@
+#include "hub.h"
+#include "group.h"
+#include "../include/crux/err.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+struct xgroup {
+	struct xhub *hub;
+	struct xlist children;         /** entries of running children */
+	struct xlist waiters;          /** tasks parked in `xgroup_wait` */
+	unsigned count;
+	int err;                       /** first error returned by a child */
+	bool owned;                    /** not yet released by `xgroup_free` */
+};
+
+static void
+wake_all(struct xgroup *grp, int rc)
+{
+	struct xlist *elem;
+	while ((elem = xlist_first(&grp->waiters, X_ASCENDING))) {
+		xhub_unpark(xcontainer(elem, struct xhub_wait, link), rc);
+	}
+}
+
+int
+xgroup_new(struct xgroup **grpp, struct xhub *hub)
+{
+	assert(grpp != NULL);
+	assert(hub != NULL);
+
+	struct xgroup *grp = malloc(sizeof(*grp));
+	if (grp == NULL) {
+		return xerrno;
+	}
+
+	grp->hub = hub;
+	xlist_init(&grp->children);
+	xlist_init(&grp->waiters);
+	grp->count = 0;
+	grp->err = 0;
+	grp->owned = true;
+
+	*grpp = grp;
+	return 0;
+}
+
+void
+xgroup_free(struct xgroup **grpp)
+{
+	assert(grpp != NULL);
+
+	struct xgroup *grp = *grpp;
+	if (grp != NULL) {
+		*grpp = NULL;
+		grp->owned = false;
+		xgroup_cancel(grp);
+		wake_all(grp, xerr_sys(ECANCELED));
+
+		// otherwise the last child releases it
+		if (grp->count == 0) {
+			free(grp);
+		}
+	}
+}
+
+void
+xgroup_add(struct xgroup *grp, struct xhub_entry *ent)
+{
+	xlist_add(&grp->children, &ent->glink, X_ASCENDING);
+	grp->count++;
+}
+
+/**
+ * @brief  Removes a finished child and resumes waiters when it decides the join
+ *
+ * This runs as a deferred function of the child so that it also happens when
+ * the child exits early or is freed along with the hub.
+ *
+ * @param  val  entry of the child
+ */
+static void
+child_done(union xvalue val)
+{
+	struct xhub_entry *ent = val.ptr;
+	struct xgroup *grp = ent->group;
+
+	xlist_del(&ent->glink);
+	ent->group = NULL;
+	grp->count--;
+
+	if (ent->group_rc < 0 && grp->err == 0) {
+		grp->err = ent->group_rc;
+		xgroup_cancel(grp);
+		wake_all(grp, grp->err);
+	}
+	else if (grp->count == 0) {
+		wake_all(grp, grp->err);
+	}
+
+	if (grp->count == 0 && !grp->owned) {
+		free(grp);
+	}
+}
+
+static void
+run_child(struct xhub *hub, union xvalue val)
+{
+	struct xhub_entry *ent = xtask_local(xtask_self());
+	int rc = xdefer(child_done, xptr(ent));
+
+	ent->group_rc = ent->group_fn(hub, val);
+	if (rc < 0) {
+		child_done(xptr(ent));
+	}
+}
+
+int
+xgroup_spawnf(struct xgroup *grp, const char *file, int line,
+		int (*fn)(struct xhub *, union xvalue), union xvalue val)
+{
+	assert(grp != NULL);
+	assert(fn != NULL);
+
+	if (grp->err < 0) {
+		return xerr_sys(ECANCELED);
+	}
+
+	struct xhub *hub = xhub_current();
+	if (hub != NULL && hub != grp->hub) {
+		return xerr_sys(EXDEV);
+	}
+
+	struct xhub_spawn req = {
+		.fn = run_child,
+		.val = val,
+		.file = file,
+		.line = line,
+		.pinned = true,
+		.group = grp,
+		.group_fn = fn,
+	};
+	xhub_inherit(&req);
+	return xhub_spawn_local(grp->hub, &req, false);
+}
+
+int
+xgroup_wait(struct xgroup *grp, int timeoutms)
+{
+	assert(grp != NULL);
+
+	if (grp->err < 0 || grp->count == 0) {
+		return grp->err;
+	}
+	return xhub_park(&grp->waiters, NULL, timeoutms);
+}
+
+void
+xgroup_cancel(struct xgroup *grp)
+{
+	assert(grp != NULL);
+
+	struct xlist *elem;
+	xlist_each(&grp->children, elem, X_ASCENDING) {
+		struct xhub_entry *ent = xcontainer(elem, struct xhub_entry, glink);
+		xtask_cancel(ent->t);
+	}
+}
+
+unsigned
+xgroup_count(const struct xgroup *grp)
+{
+	assert(grp != NULL);
+
+	return grp->count;
+}
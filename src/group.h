@@ -0,0 +1,13 @@
+#include "../include/crux/group.h"
+#include "../include/crux/list.h"
+
+struct xhub_entry;
+
+/**
+ * @brief  Links a newly spawned child into its group
+ *
+ * @param  grp  group the child was spawned into
+ * @param  ent  entry of the child
+ */
+XLOCAL void
+xgroup_add(struct xgroup *grp, struct xhub_entry *ent);
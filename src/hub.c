@@ -1,10 +1,7 @@
-#include "../include/crux/hub.h"
+#include "hub.h"
+#include "chan.h"
+#include "group.h"
 #include "../include/crux/err.h"
-#include "../include/crux/list.h"
-
-#include "task.h"
-#include "heap.h"
-#include "poll.h"
 
 #include <unistd.h>
 #include <string.h>
@@ -13,6 +10,7 @@
 #include <sys/socket.h>
 #include <sys/resource.h>
 #include <sys/uio.h>
+#include <sys/stat.h>
 #include <assert.h>
 #if HAS_EXECINFO
 # include <execinfo.h>
@@ -63,41 +61,6 @@ const char *signame[32] = {
 #endif
 };
 
-struct xhub_entry {
-	uint64_t magic;
-#define MAGIC UINT64_C(0x989b369eac2205a3)
-	struct xheap_entry hent;
-	struct xlist lent; // list handle for closed, immediate, wake, sig, and io lists
-	struct xlist pent; // list handle for polled list
-	struct xtask *t;
-	union xvalue vinit;
-	struct xhub *hub;
-	void (*fn)(struct xhub *, union xvalue val);
-	int poll_id, poll_type;
-	bool detached;
-};
-
-struct xhub_io {
-	struct xlist in, out;
-	int type;
-};
-
-struct xhub {
-	struct xmgr mgr;
-	struct xpoll poll;
-	unsigned npolled;
-	unsigned ndetached;
-	int maxfd;
-	bool running;
-	struct xheap timeout;
-	struct xlist closed;
-	struct xlist immediate;
-	struct xlist polled;
-	struct xlist wake;
-	struct xlist sig[31];
-	struct xhub_io io[0];
-};
-
 static thread_local struct xhub *current_hub = NULL;
 static thread_local struct xhub_entry *current_entry = NULL;
 
@@ -108,42 +71,314 @@ get_sig(struct xhub *hub, int signo)
 	return &hub->sig[signo-1];
 }
 
+/**
+ * @brief  Looks up the io entry for a descriptor without allocating it
+ *
+ * @param  hub  hub pointer
+ * @param  fd   file descriptor
+ * @return  entry pointer or NULL if nothing has been scheduled on its page
+ */
 static struct xhub_io *
-get_io(struct xhub *hub, int fd)
+find_io(struct xhub *hub, int fd)
+{
+	unsigned page = (unsigned)fd / XHUB_IO_PAGE;
+	if (fd < 0 || page >= hub->npages || hub->io[page] == NULL) {
+		return NULL;
+	}
+	return &hub->io[page][fd % XHUB_IO_PAGE];
+}
+
+/**
+ * @brief  Gets the io entry for a descriptor, allocating its page if needed
+ *
+ * @param  hub  hub pointer
+ * @param  fd   file descriptor
+ * @param[out]  iop  entry pointer
+ * @return  0 on success, or -errno
+ */
+static int
+get_io(struct xhub *hub, int fd, struct xhub_io **iop)
+{
+	if (fd < 0 || fd >= hub->maxfd) {
+		return xerr_sys(EBADF);
+	}
+
+	unsigned page = (unsigned)fd / XHUB_IO_PAGE;
+	if (page >= hub->npages) {
+		unsigned n = hub->npages ? hub->npages : 4;
+		while (n <= page) { n *= 2; }
+		struct xhub_io **dir = realloc(hub->io, n * sizeof(*dir));
+		if (dir == NULL) {
+			return xerrno;
+		}
+		memset(dir + hub->npages, 0, (n - hub->npages) * sizeof(*dir));
+		hub->io = dir;
+		hub->npages = n;
+	}
+
+	struct xhub_io *io = hub->io[page];
+	if (io == NULL) {
+		io = malloc(XHUB_IO_PAGE * sizeof(*io));
+		if (io == NULL) {
+			return xerrno;
+		}
+		for (int i = 0; i < XHUB_IO_PAGE; i++) {
+			io[i].type = 0;
+			io[i].readable = true;
+			io[i].stream = -1;
+			io[i].busy_poll = false;
+			xlist_init(&io[i].in);
+			xlist_init(&io[i].out);
+#if HAS_IO_URING
+			xlist_init(&io[i].ring);
+#endif
+		}
+		hub->io[page] = io;
+	}
+
+	*iop = &io[fd % XHUB_IO_PAGE];
+	return 0;
+}
+
+static inline uint64_t
+clock_tick(const struct xhub *hub)
+{
+	return (uint64_t)X_NSEC_TO_MSEC(XCLOCK_NSEC(&hub->poll.clock));
+}
+
+static int64_t
+now_ns(void)
+{
+	struct timespec c;
+	xclock_mono(&c);
+	return XCLOCK_NSEC(&c);
+}
+
+static void
+record_time(uint64_t *buckets, uint64_t ns)
+{
+	int bucket = 63 - __builtin_clzll(ns | 1);
+	if (bucket >= XHUB_TIME_BUCKETS) { bucket = XHUB_TIME_BUCKETS - 1; }
+	buckets[bucket]++;
+}
+
+static struct xhub_site_node *
+find_site(struct xhub *hub, const char *file, int line)
+{
+	struct xhub_site_node *node;
+	for (node = hub->sites; node; node = node->next) {
+		if (node->site.line == line && node->site.file == file) { return node; }
+	}
+
+	// accounting is best effort so the task still runs without a site
+	node = calloc(1, sizeof(*node));
+	if (node == NULL) { return NULL; }
+	node->site.file = file;
+	node->site.line = line;
+	node->next = hub->sites;
+	hub->sites = node;
+	return node;
+}
+
+static void
+record_site(struct xhub_entry *ent)
+{
+	struct xhub_site *site = &ent->site->site;
+	site->tasks++;
+	site->cpu_ns += ent->cpu_ns;
+	if (ent->cpu_ns > site->cpu_max) { site->cpu_max = ent->cpu_ns; }
+	record_time(site->cpu, ent->cpu_ns);
+}
+
+static bool
+has_timer(struct xhub_entry *ent)
+{
+	return xwheel_is_added(&ent->went) || ent->hent.key != XHEAP_NONE;
+}
+
+static int
+add_timer(struct xhub_entry *ent, int64_t deadline)
+{
+	struct xhub *hub = ent->hub;
+
+	// an idle wheel may have fallen behind the clock
+	xwheel_advance(&hub->wheel, clock_tick(hub));
+
+	// only deadlines on a millisecond fit the wheel, finer ones stay exact
+	if (deadline % X_NSEC_PER_MSEC == 0 &&
+			xwheel_add(&hub->wheel, &ent->went, (uint64_t)(deadline / X_NSEC_PER_MSEC)) == 0) {
+		return 0;
+	}
+
+	ent->hent.prio = deadline;
+	int rc = xheap_add(&hub->timeout, &ent->hent);
+	return rc < 0 ? rc : 0;
+}
+
+static void
+remove_timer(struct xhub_entry *ent)
+{
+	if (xwheel_is_added(&ent->went)) {
+		xwheel_remove(&ent->hub->wheel, &ent->went);
+	}
+	if (ent->hent.key != XHEAP_NONE) {
+		xheap_remove(&ent->hub->timeout, &ent->hent);
+	}
+}
+
+/**
+ * @brief  Gets the task with the earliest expired timeout
+ *
+ * @param  hub  hub pointer
+ * @return  entry pointer or NULL if no timeouts have expired
+ */
+static struct xhub_entry *
+due_timer(struct xhub *hub)
+{
+	struct xwheel_entry *went;
+	struct xheap_entry *hent;
+
+	xwheel_advance(&hub->wheel, clock_tick(hub));
+	if ((went = xwheel_due(&hub->wheel))) {
+		return xcontainer(went, struct xhub_entry, went);
+	}
+
+	hent = xheap_get(&hub->timeout, XHEAP_ROOT);
+	if (hent && hent->prio <= XCLOCK_NSEC(&hub->poll.clock)) {
+		return xcontainer(hent, struct xhub_entry, hent);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief  Gets the number of nanoseconds until the next timer work
+ *
+ * @param  hub  hub pointer
+ * @return  nanoseconds, or -1 if there are no timeouts
+ */
+static int64_t
+next_timer(struct xhub *hub)
 {
-	xassert(fd >= 0 && fd < hub->maxfd);
-	return &hub->io[fd];
+	int64_t now = XCLOCK_NSEC(&hub->poll.clock);
+	uint64_t tick = xwheel_next(&hub->wheel);
+	int64_t next = tick == UINT64_MAX ? -1 : X_MSEC_TO_NSEC((int64_t)tick);
+	struct xheap_entry *hent = xheap_get(&hub->timeout, XHEAP_ROOT);
+
+	if (hent && (next < 0 || hent->prio < next)) {
+		next = hent->prio;
+	}
+
+	if (next < 0) { return -1; }
+	return next > now ? next - now : 0;
 }
 
 static bool
 is_scheduled(struct xhub_entry *ent)
 {
 	return (ent->poll_type != 0 ||
-			ent->hent.key != XHEAP_NONE ||
+			has_timer(ent) ||
 			xlist_is_added(&ent->lent));
 }
 
 static int
 schedule_immediate(struct xhub_entry *ent)
 {
-	xlist_add(&ent->hub->immediate, &ent->lent, X_ASCENDING);
+	struct xhub *hub = ent->hub;
+	if (hub->account && ent->ready_ns == 0) { ent->ready_ns = now_ns(); }
+	xlist_add(&hub->immediate[ent->prio], &ent->lent, X_ASCENDING);
 	return 0;
 }
 
 static int
-schedule_timeout(struct xhub_entry *ent, int ms)
+schedule_timeout(struct xhub_entry *ent, int64_t deadline)
 {
-	struct xhub *h = ent->hub;
-	ent->hent.prio = X_MSEC_TO_NSEC((int64_t)ms) + XCLOCK_NSEC(&h->poll.clock);
 	ent->detached = false;
-	int rc = xheap_add(&h->timeout, &ent->hent);
-	return rc < 0 ? rc : 0;
+	return add_timer(ent, deadline);
+}
+
+/**
+ * @brief  Converts a millisecond timeout to nanoseconds
+ *
+ * `XTIMEOUT_NONE` and `XTIMEOUT_DETACH` are passed through as they are.
+ */
+static inline int64_t
+ms_timeout(int ms)
+{
+	return ms < 0 ? ms : X_MSEC_TO_NSEC((int64_t)ms);
+}
+
+/**
+ * @brief  Rounds a time up to the next whole millisecond
+ */
+static inline int64_t
+round_ms(int64_t ns)
+{
+	return (ns + X_NSEC_PER_MSEC - 1) / X_NSEC_PER_MSEC * X_NSEC_PER_MSEC;
 }
 
+/**
+ * @brief  Gets the time a wait ends by, shortened to the task's deadline
+ *
+ * Timeouts in whole milliseconds are rounded up to end on a millisecond so
+ * their timers go on the wheel. Finer timeouts and deadlines are kept exact.
+ *
+ * @param  ent      entry about to wait
+ * @param  timeout  timeout in nanoseconds, or negative for none
+ * @param[out]  deadline  monotonic time in nanoseconds, or 0 for none
+ * @return  0 on success, -ETIMEDOUT if the task's deadline has passed
+ */
 static int
-schedule_sig(struct xhub_entry *ent, int signo)
+wait_deadline(struct xhub_entry *ent, int64_t timeout, int64_t *deadline)
 {
-	struct xhub *hub = ent->hub;
+	int64_t end = 0;
+
+	if (timeout >= 0) {
+		end = XCLOCK_NSEC(&ent->hub->poll.clock) + timeout;
+		if (timeout % X_NSEC_PER_MSEC == 0) { end = round_ms(end); }
+	}
+
+	if (ent->deadline != 0) {
+		if (ent->deadline <= now_ns()) { return xerr_sys(ETIMEDOUT); }
+		if (end == 0 || ent->deadline < end) { end = ent->deadline; }
+	}
+
+	*deadline = end;
+	return 0;
+}
+
+/**
+ * @brief  Gives up control until whatever the task waits on resumes it
+ *
+ * @param  ent  entry of the current task
+ * @return  value the task was resumed with, or -ECANCELED
+ */
+static int
+yield_wait(struct xhub_entry *ent)
+{
+	int rc = xyield(xzero).i;
+	if (ent->interrupted) {
+		ent->interrupted = false;
+		rc = xerr_sys(ECANCELED);
+	}
+	return rc;
+}
+
+static struct xhub_wait *
+single_wait(struct xhub_entry *ent, void *data)
+{
+	ent->wait.ent = ent;
+	ent->wait.data = data;
+	ent->wait.idx = 0;
+	ent->waits = &ent->wait;
+	ent->nwaits = 1;
+	return &ent->wait;
+}
+
+static int
+schedule_sig(struct xhub_wait *w, int signo)
+{
+	struct xhub *hub = w->ent->hub;
 	struct xlist *sig = get_sig(hub, signo);
 
 	if (xlist_is_empty(sig)) {
@@ -153,7 +388,7 @@ schedule_sig(struct xhub_entry *ent, int signo)
 		}
 	}
 
-	xlist_add(sig, &ent->lent, X_ASCENDING);
+	xlist_add(sig, &w->link, X_ASCENDING);
 	return 0;
 }
 
@@ -165,15 +400,47 @@ schedule_wake(struct xhub_entry *ent)
 	return 0;
 }
 
+/**
+ * @brief  Lets the driver spin on a socket while it has nothing to read
+ *
+ * This is tried once per descriptor, and errors such as a descriptor that
+ * isn't a socket are ignored.
+ *
+ * @param  hub  hub pointer
+ * @param  fd   file descriptor
+ * @param  io   state of the descriptor
+ */
+static void
+set_busy_poll(struct xhub *hub, int fd, struct xhub_io *io)
+{
+#ifdef SO_BUSY_POLL
+	if (hub->spin_sockopt && !io->busy_poll) {
+		int usec = (int)X_NSEC_TO_USEC(hub->spin_max_ns);
+		setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec));
+		io->busy_poll = true;
+	}
+#else
+	(void)hub;
+	(void)fd;
+	(void)io;
+#endif
+}
+
 static int
-schedule_io(struct xhub_entry *ent, int fd, int type)
+schedule_io(struct xhub_wait *w, int fd, int type)
 {
-	struct xhub *hub = ent->hub;
-	struct xhub_io *io = get_io(hub, fd);
+	struct xhub *hub = w->ent->hub;
+	struct xhub_io *io;
+	int rc = get_io(hub, fd, &io);
+	if (rc < 0) {
+		return rc;
+	}
+
+	set_busy_poll(hub, fd, io);
 
 	int next = io->type | type;
 	if (next != io->type) {
-		int rc = xpoll_ctl(&hub->poll, fd, io->type, next);
+		rc = xpoll_ctl(&hub->poll, fd, io->type, next);
 		if (rc < 0) {
 			return rc;
 		}
@@ -181,46 +448,106 @@ schedule_io(struct xhub_entry *ent, int fd, int type)
 	}
 
 	if (type & XPOLL_IN) {
-		xlist_add(&io->in, &ent->lent, X_ASCENDING);
+		xlist_add(&io->in, &w->link, X_ASCENDING);
 	}
 	else if (type & XPOLL_OUT) {
-		xlist_add(&io->out, &ent->lent, X_ASCENDING);
+		xlist_add(&io->out, &w->link, X_ASCENDING);
 	}
 
 	return 0;
 }
 
+static void
+remove_waits(struct xhub_entry *ent)
+{
+	for (int i = 0; i < ent->nwaits; i++) {
+		if (xlist_is_added(&ent->waits[i].link)) {
+			xlist_del(&ent->waits[i].link);
+		}
+	}
+	ent->nwaits = 0;
+}
+
 static int
-schedule_poll(struct xhub_entry *ent, int id, int type, int timeoutms)
+schedule_select(struct xhub_entry *ent, const struct xselect *ops)
 {
-	int rc;
-	if (timeoutms < 0) {
+	int rc = 0;
+
+	for (int i = 0; i < ent->nwaits && rc == 0; i++) {
+		struct xhub_wait *w = &ent->waits[i];
+		switch (ops[i].type) {
+		case XPOLL_IN:
+		case XPOLL_OUT:
+			rc = schedule_io(w, ops[i].id, ops[i].type);
+			break;
+		case XPOLL_SIG:
+			rc = ops[i].id > 0 && ops[i].id < 32 ?
+				schedule_sig(w, ops[i].id) : xerr_sys(EINVAL);
+			break;
+		case XSELECT_SEND:
+		case XSELECT_RECV:
+			xlist_add(xchan_waiters(ops[i].chan, ops[i].type == XSELECT_SEND),
+					&w->link, X_ASCENDING);
+			break;
+		default:
+			rc = xerr_sys(EINVAL);
+		}
+	}
+
+	if (rc < 0) {
+		remove_waits(ent);
+	}
+	return rc;
+}
+
+static int
+schedule_poll(struct xhub_entry *ent, int id, int type, void *data, int64_t timeout)
+{
+	if (ent->cancelled) {
+		return xerr_sys(ECANCELED);
+	}
+
+	int64_t deadline;
+	int rc = wait_deadline(ent, timeout, &deadline);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (deadline == 0) {
 		ent->hent.key = XHEAP_NONE;
-		ent->detached = timeoutms == XTIMEOUT_DETACH;
+		ent->detached = timeout == XTIMEOUT_DETACH;
 	}
 	else {
-		rc = schedule_timeout(ent, timeoutms);
+		rc = schedule_timeout(ent, deadline);
 		if (rc < 0) { return rc; }
 	}
 
 	switch (XPOLL_TYPE(type)) {
 	case XPOLL_IN:
 	case XPOLL_OUT:
-		rc = schedule_io(ent, id, type);
+		rc = schedule_io(single_wait(ent, NULL), id, type);
 		break;
 	case XPOLL_SIG:
-		rc = schedule_sig(ent, id);
+		rc = schedule_sig(single_wait(ent, NULL), id);
 		break;
 	case XPOLL_WAKE:
 		rc = schedule_wake(ent);
 		break;
+	case XPOLL_PARK:
+		xlist_add(ent->park, &single_wait(ent, data)->link, X_ASCENDING);
+		rc = 0;
+		break;
+	case XPOLL_SELECT:
+		rc = schedule_select(ent, data);
+		break;
 	default:
 		rc = xerr_sys(EINVAL);
 	}
 
 	if (rc < 0) {
-		if (timeoutms >= 0) {
-			xheap_remove(&ent->hub->timeout, &ent->hent);
+		ent->nwaits = 0;
+		if (deadline != 0) {
+			remove_timer(ent);
 		}
 		return rc;
 	}
@@ -229,9 +556,11 @@ schedule_poll(struct xhub_entry *ent, int id, int type, int timeoutms)
 	ent->hub->npolled++;
 	if (ent->detached) {
 		ent->hub->ndetached++;
+		if (ent->hub->pool) { xhub_pool_busy(ent->hub->pool, -1); }
 	}
 	ent->poll_id = id;
 	ent->poll_type = type;
+	ent->wait_idx = -1;
 	return 0;
 }
 
@@ -246,9 +575,8 @@ unschedule(struct xhub_entry *ent)
 		xlist_del(&ent->pent);
 	}
 
-	if (ent->hent.key != XHEAP_NONE) {
-		xheap_remove(&ent->hub->timeout, &ent->hent);
-	}
+	remove_waits(ent);
+	remove_timer(ent);
 
 	if (ent->poll_type) {
 		ent->poll_id = -1;
@@ -259,13 +587,16 @@ unschedule(struct xhub_entry *ent)
 		if (ent->detached) {
 			assert(ent->hub->ndetached > 0);
 			ent->hub->ndetached--;
+			if (ent->hub->pool) { xhub_pool_busy(ent->hub->pool, 1); }
 		}
 	}
 }
 
 static void
-mark_closed(struct xhub_entry *ent)
+mark_closed(struct xhub_wait *w)
 {
+	struct xhub_entry *ent = w->ent;
+	ent->wait_idx = w->idx;
 	unschedule(ent);
 	xlist_add(&ent->hub->closed, &ent->lent, X_ASCENDING);
 }
@@ -281,9 +612,9 @@ xhub_new(struct xhub **hubp)
 	if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
 		return xerrno;
 	}
-	maxfd = limit.rlim_max >= 1<<16 ? (1<<16) - 1 : (int)limit.rlim_max;
+	maxfd = limit.rlim_max >= INT_MAX ? INT_MAX : (int)limit.rlim_max;
 
-	struct xhub *hub = malloc(sizeof(*hub) + maxfd*sizeof(hub->io[0]));
+	struct xhub *hub = malloc(sizeof(*hub));
 	if (hub == NULL) {
 		return xerrno;
 	}
@@ -300,28 +631,56 @@ xhub_new(struct xhub **hubp)
 	hub->ndetached = 0;
 	hub->npolled = 0;
 	hub->running = false;
+	hub->woken = false;
+	hub->batch = 1;
+	hub->epos = 0;
+	hub->elen = 0;
 	hub->maxfd = maxfd;
+	hub->npages = 0;
+	hub->io = NULL;
+	hub->pool = NULL;
+	hub->pool_idx = -1;
+	hub->pool_done = false;
+	hub->nload = 0;
+	hub->nqueued = 0;
 
 	rc = xheap_init(&hub->timeout);
 	if (rc < 0) {
 		goto err_heap;
 	}
+	xwheel_init(&hub->wheel, clock_tick(hub));
 
 	xlist_init(&hub->closed);
-	xlist_init(&hub->immediate);
+	for (int i = 0; i < XHUB_PRIOS; i++) {
+		xlist_init(&hub->immediate[i]);
+		hub->prio_weight[i] = 0;
+	}
+	hub->prio_weight[XHUB_PRIO_NORMAL] = 8;
+	hub->prio_last = -1;
+	hub->prio_streak = 0;
+	hub->io_budget = XHUB_IO_BUDGET;
+	hub->io_budget_ns = 0;
+	hub->spin_max_ns = 0;
+	hub->spin_ns = 0;
+	hub->spin_sockopt = false;
+	hub->ring = true;
 	xlist_init(&hub->polled);
 	xlist_init(&hub->wake);
+	xlist_init(&hub->inbox);
+	hub->post_stub.next = NULL;
+	hub->post_head = &hub->post_stub;
+	hub->post_tail = &hub->post_stub;
+	hub->post_wake = false;
+	hub->noffload = 0;
+	pthread_mutex_init(&hub->lock, NULL);
+	memset(&hub->stats, 0, sizeof(hub->stats));
+	hub->account = false;
+	hub->sites = NULL;
 
 	for (size_t i = 0; i < xlen(hub->sig); i++) {
 		xlist_init(&hub->sig[i]);
 	}
 
-	for (int i = 0; i < maxfd; i++) {
-		hub->io[i].type = 0;
-		xlist_init(&hub->io[i].in);
-		xlist_init(&hub->io[i].out);
-	}
-
 	*hubp = hub;
 	return 0;
 
@@ -334,6 +693,164 @@ err_mgr:
 	return rc;
 }
 
+#if HAS_IO_URING
+
+static void
+ring_discard(uint64_t udata, int32_t res, void *data)
+{
+	(void)res;
+	if (udata != 0) {
+		(*(unsigned *)data)--;
+	}
+}
+
+/**
+ * @brief  Cancels every operation in the ring and waits for them to complete
+ *
+ * The kernel may still write into task stacks until an operation completes,
+ * so the tasks cannot be freed before this returns.
+ *
+ * @param  hub  hub pointer
+ */
+static void
+ring_cancel_all(struct xhub *hub)
+{
+	struct xlist *elem;
+	struct xhub_entry *ent;
+	unsigned inflight = 0;
+
+	xlist_each(&hub->polled, elem, X_ASCENDING) {
+		ent = xcontainer(elem, struct xhub_entry, pent);
+		if (ent->poll_type == XPOLL_RING) {
+			inflight++;
+		}
+	}
+
+	// a full submission queue drains once pending completions are reaped;
+	// an operation left uncancelled would keep the wait below from ending
+	xlist_each(&hub->polled, elem, X_ASCENDING) {
+		ent = xcontainer(elem, struct xhub_entry, pent);
+		if (ent->poll_type == XPOLL_RING) {
+			while (xpoll_cancel(&hub->poll, (uintptr_t)ent) == xerr_sys(EBUSY) &&
+					xpoll_reap(&hub->poll, false, ring_discard, &inflight) >= 0) {}
+		}
+	}
+
+	while (inflight > 0 &&
+			xpoll_reap(&hub->poll, true, ring_discard, &inflight) >= 0) {}
+}
+
+#endif
+
+static void
+post_push(struct xhub *hub, struct xhub_post *post)
+{
+	atomic_store_explicit(&post->next, NULL, memory_order_relaxed);
+	struct xhub_post *prev = atomic_exchange_explicit(&hub->post_head, post,
+			memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, post, memory_order_release);
+}
+
+/**
+ * @brief  Takes the oldest post from the queue
+ *
+ * Only the hub's own thread may call this. A producer that has swapped the
+ * head but not yet linked its node makes the queue look empty; the post is
+ * picked up on the wake that producer sends next.
+ *
+ * @param  hub  hub pointer
+ * @return  post pointer or NULL
+ */
+static struct xhub_post *
+post_pop(struct xhub *hub)
+{
+	struct xhub_post *tail = hub->post_tail;
+	struct xhub_post *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+	if (tail == &hub->post_stub) {
+		if (next == NULL) { return NULL; }
+		hub->post_tail = tail = next;
+		next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	}
+
+	if (next == NULL) {
+		if (tail != atomic_load_explicit(&hub->post_head, memory_order_acquire)) {
+			return NULL;
+		}
+		// put the stub back behind the last node so it can be taken
+		post_push(hub, &hub->post_stub);
+		next = atomic_load_explicit(&tail->next, memory_order_acquire);
+		if (next == NULL) { return NULL; }
+	}
+
+	hub->post_tail = next;
+	return tail;
+}
+
+static bool
+has_posts(struct xhub *hub)
+{
+	return hub->post_tail != &hub->post_stub ||
+		atomic_load_explicit(&hub->post_stub.next, memory_order_acquire) != NULL;
+}
+
+/**
+ * @brief  Spawns every task posted from other threads
+ *
+ * @param  hub  hub pointer
+ * @return  number of tasks spawned
+ */
+static unsigned
+drain_posts(struct xhub *hub)
+{
+	struct xhub_post *post;
+	unsigned n = 0;
+
+	// clear first so a post racing with the drain sends a fresh wake
+	atomic_store(&hub->post_wake, false);
+
+	while ((post = post_pop(hub))) {
+		if (post->req.fn == NULL) {
+			xhub_offload_done(post, false);
+			continue;
+		}
+		if (xhub_spawn_local(hub, &post->req, true) < 0) {
+			atomic_fetch_sub(&hub->nload, 1);
+			if (hub->pool) { xhub_pool_busy(hub->pool, -1); }
+		}
+		free(post);
+		n++;
+	}
+
+	if (n > 0) {
+		hub->stats.posted += n;
+		hub->stats.post_drains++;
+	}
+	return n;
+}
+
+/**
+ * @brief  Releases queued posts without running them
+ *
+ * Spawn requests are dropped and offloaded calls are released since their
+ * tasks are already gone.
+ *
+ * @param  hub  hub pointer
+ */
+static void
+drain_offloads(struct xhub *hub)
+{
+	struct xhub_post *post;
+	while ((post = post_pop(hub))) {
+		if (post->req.fn == NULL) {
+			xhub_offload_done(post, true);
+		}
+		else {
+			free(post);
+		}
+	}
+}
+
 static void
 free_hent(struct xheap_entry *hent, void *data)
 {
@@ -343,6 +860,37 @@ free_hent(struct xheap_entry *hent, void *data)
 	xtask_free(&ent->t);
 }
 
+static void
+free_went(struct xwheel_entry *went, void *data)
+{
+	(void)data;
+	struct xhub_entry *ent = xcontainer(went, struct xhub_entry, went);
+	unschedule(ent);
+	xtask_free(&ent->t);
+}
+
+/**
+ * @brief  Finds a task still queued on the hub while it is being freed
+ *
+ * @param  hub    hub pointer
+ * @param  lists  immediate and closed lists
+ * @param  n      number of lists
+ * @return  first entry found, or `NULL` if none is left
+ */
+static struct xhub_entry *
+first_task(struct xhub *hub, struct xlist **lists, size_t n)
+{
+	struct xlist *elem;
+	for (size_t i = 0; i < n; i++) {
+		elem = xlist_first(lists[i], X_ASCENDING);
+		if (elem != NULL) {
+			return xcontainer(elem, struct xhub_entry, lent);
+		}
+	}
+	elem = xlist_first(&hub->polled, X_ASCENDING);
+	return elem ? xcontainer(elem, struct xhub_entry, pent) : NULL;
+}
+
 void
 xhub_free(struct xhub **hubp)
 {
@@ -355,45 +903,125 @@ xhub_free(struct xhub **hubp)
 
 		*hubp = NULL;
 
-		struct xlist *elem, *lists[] = {
+		struct xlist *lists[] = {
 			&hub->closed,
-			&hub->immediate,
+			&hub->immediate[XHUB_PRIO_HIGH],
+			&hub->immediate[XHUB_PRIO_NORMAL],
+			&hub->immediate[XHUB_PRIO_LOW],
 		};
 
-		for (size_t i = 0; i < xlen(lists); i++) {
-			xlist_each(lists[i], elem, X_ASCENDING) {
-				ent = xcontainer(elem, struct xhub_entry, lent);
+#if HAS_IO_URING
+		if (xpoll_has_ring(&hub->poll)) {
+			ring_cancel_all(hub);
+		}
+#endif
+
+		// deferred functions of freed tasks may resume others, such as a
+		// group child waking its joiner, so take one task at a time and
+		// repeat until the timers hold nothing either
+		for (;;) {
+			while ((ent = first_task(hub, lists, xlen(lists))) != NULL) {
 				unschedule(ent);
 				xtask_free(&ent->t);
 			}
+			if (hub->wheel.count == 0 && xheap_count(&hub->timeout) == 0) {
+				break;
+			}
+			xwheel_clear(&hub->wheel, free_went, NULL);
+			xheap_clear(&hub->timeout, free_hent, NULL);
 		}
 
-		xlist_each(&hub->polled, elem, X_ASCENDING) {
-			ent = xcontainer(elem, struct xhub_entry, pent);
-			unschedule(ent);
-			xtask_free(&ent->t);
-		}
-
-		xheap_clear(&hub->timeout, free_hent, NULL);
 		xheap_final(&hub->timeout);
+		xhub_pool_clear(hub);
+
+		// workers still hold offloaded calls that will post back here, and
+		// only let go of the hub after their post and wake are done
+		drain_offloads(hub);
+		while (atomic_load(&hub->noffload) > 0) {
+			struct timespec ts = XCLOCK_MAKE_MSEC(1);
+			nanosleep(&ts, NULL);
+			drain_offloads(hub);
+		}
+		drain_offloads(hub);
+		pthread_mutex_destroy(&hub->lock);
 		xpoll_final(&hub->poll);
 		xmgr_final(&hub->mgr);
+		for (unsigned i = 0; i < hub->npages; i++) {
+			free(hub->io[i]);
+		}
+		free(hub->io);
+		while (hub->sites != NULL) {
+			struct xhub_site_node *next = hub->sites->next;
+			free(hub->sites);
+			hub->sites = next;
+		}
 		free(hub);
 	}
 }
 
+static void
+task_done(struct xhub *hub)
+{
+	atomic_fetch_sub(&hub->nload, 1);
+	if (hub->pool) { xhub_pool_busy(hub->pool, -1); }
+}
+
+/**
+ * @brief  Records how long a task waited to run and how long it then ran
+ *
+ * @param  ent    entry that was resumed
+ * @param  start  time the task was resumed
+ */
+static void
+record_resume(struct xhub_entry *ent, int64_t start)
+{
+	struct xhub_stats *stats = &ent->hub->stats;
+	uint64_t run = (uint64_t)(now_ns() - start);
+
+	ent->cpu_ns += run;
+	ent->run_ns = 0;
+	stats->resumed++;
+	stats->run_ns += run;
+	if (run > stats->run_max) { stats->run_max = run; }
+	record_time(stats->run, run);
+}
+
 static int
 invoke_direct(struct xhub_entry *ent, union xvalue val)
 {
+	struct xhub *hub = ent->hub;
+	int64_t start = 0;
+
 	unschedule(ent);
 
+	// the time is taken before the task runs so its own wakes are stamped
+	if (hub->account) {
+		start = now_ns();
+		ent->run_ns = start;
+		if (ent->ready_ns > 0 && ent->ready_ns <= start) {
+			uint64_t wait = (uint64_t)(start - ent->ready_ns);
+			hub->stats.wait_ns += wait;
+			if (wait > hub->stats.wait_max) { hub->stats.wait_max = wait; }
+			record_time(hub->stats.wait, wait);
+		}
+	}
+	ent->ready_ns = 0;
+	ent->io_calls = 0;
+	ent->io_start = 0;
+
 	struct xhub_entry *tmp = current_entry;
 	current_entry = ent;
 	xresume(ent->t, val);
 	current_entry = tmp;
 
+	if (start > 0) {
+		record_resume(ent, start);
+	}
+
 	if (!xtask_alive(ent->t)) {
+		if (ent->site) { record_site(ent); }
 		xtask_free(&ent->t);
+		task_done(hub);
 	}
 	else if (!is_scheduled(ent)) {
 		schedule_immediate(ent);
@@ -403,28 +1031,59 @@ invoke_direct(struct xhub_entry *ent, union xvalue val)
 }
 
 static int
-invoke_timeout(struct xhub_entry *ent)
+invoke_wait(struct xhub_wait *w, union xvalue val)
 {
-	return invoke_direct(ent, ent->poll_type ? xint(xerr_sys(ETIMEDOUT)) : xzero);
+	w->ent->wait_idx = w->idx;
+	return invoke_direct(w->ent, val);
 }
 
-static int
-invoke_sig(struct xhub *hub, struct xevent *ev)
+/**
+ * @brief  Resumes every task waiting on a list, higher classes first
+ *
+ * Resuming a task removes all of its wait nodes, which may include others
+ * further along in the same lists, so this always takes the first node.
+ *
+ * @param  list  list of `struct xhub_wait` nodes
+ * @param  val   value to resume the tasks with
+ */
+static void
+invoke_waits(struct xlist *list, union xvalue val)
 {
-	struct xlist *sig = get_sig(hub, ev->id), tmp, *elem;
-	struct xhub_entry *ent;
-
-	if (xlist_is_empty(sig)) {
-		xpoll_ctl(&hub->poll, ev->id, XPOLL_SIG, XPOLL_NONE);
-		kill(getpid(), ev->id);
+	struct xlist byprio[XHUB_PRIOS], *elem;
+	for (int i = 0; i < XHUB_PRIOS; i++) {
+		xlist_init(&byprio[i]);
 	}
-	else {
-		xlist_replace(&tmp, sig);
-		xlist_each(&tmp, elem, X_ASCENDING) {
-			ent = xcontainer(elem, struct xhub_entry, lent);
-			invoke_direct(ent, xint(ev->id));
+	while ((elem = xlist_first(list, X_ASCENDING))) {
+		struct xhub_wait *w = xcontainer(elem, struct xhub_wait, link);
+		xlist_del(elem);
+		xlist_add(&byprio[w->ent->prio], elem, X_ASCENDING);
+	}
+	for (int i = 0; i < XHUB_PRIOS; i++) {
+		while ((elem = xlist_first(&byprio[i], X_ASCENDING))) {
+			invoke_wait(xcontainer(elem, struct xhub_wait, link), val);
 		}
 	}
+}
+
+static int
+invoke_timeout(struct xhub_entry *ent)
+{
+	return invoke_direct(ent, ent->poll_type ? xint(xerr_sys(ETIMEDOUT)) : xzero);
+}
+
+static int
+invoke_sig(struct xhub *hub, struct xevent *ev)
+{
+	struct xlist *sig = get_sig(hub, ev->id), tmp;
+
+	if (xlist_is_empty(sig)) {
+		xpoll_ctl(&hub->poll, ev->id, XPOLL_SIG, XPOLL_NONE);
+		kill(getpid(), ev->id);
+	}
+	else {
+		xlist_replace(&tmp, sig);
+		invoke_waits(&tmp, xint(ev->id));
+	}
 	
 	return 1;
 }
@@ -435,7 +1094,15 @@ invoke_wake(struct xhub *hub)
 	struct xlist *wake = &hub->wake, tmp, *elem;
 	struct xhub_entry *ent;
 
-	if (!xlist_is_empty(wake)) {
+	// pooled hubs are also woken to pick up spawn requests
+	if (hub->pool) {
+		xhub_pool_drain(hub);
+	}
+
+	drain_posts(hub);
+
+	// only tasks waiting on XPOLL_WAKE are resumed for an explicit wake
+	if (atomic_exchange(&hub->woken, false) && !xlist_is_empty(wake)) {
 		xlist_replace(&tmp, wake);
 		xlist_each(&tmp, elem, X_ASCENDING) {
 			ent = xcontainer(elem, struct xhub_entry, lent);
@@ -449,12 +1116,13 @@ invoke_wake(struct xhub *hub)
 static int
 invoke_io(struct xhub *hub, struct xevent *ev)
 {
-	struct xhub_io *io = get_io(hub, ev->id);
-	struct xlist inlist, outlist, *elem;
-	struct xhub_entry *ent;
+	struct xhub_io *io = find_io(hub, ev->id);
+	struct xlist inlist, outlist;
 	union xvalue val = xzero;
 	bool in = false, out = false;
 
+	xassert(io != NULL);
+
 	if (ev->type & XPOLL_ERR) {
 		val = xint(ev->errcode);
 		in = out = true;
@@ -469,26 +1137,56 @@ invoke_io(struct xhub *hub, struct xevent *ev)
 		out = (ev->type & XPOLL_OUT);
 	}
 
+	if (in) { io->readable = true; }
 	if (in) { xlist_replace(&inlist, &io->in); }
 	if (out) { xlist_replace(&outlist, &io->out); }
 
-	if (in) {
-		xlist_each(&inlist, elem, X_ASCENDING) {
-			ent = xcontainer(elem, struct xhub_entry, lent);
-			invoke_direct(ent, val);
+	// every waiter became runnable when the event was seen, not when its
+	// turn comes
+	if (hub->account) {
+		int64_t now = now_ns();
+		struct xlist *elem;
+		if (in) {
+			xlist_each(&inlist, elem, X_ASCENDING) {
+				xcontainer(elem, struct xhub_wait, link)->ent->ready_ns = now;
+			}
 		}
-	}
-
-	if (out) {
-		xlist_each(&outlist, elem, X_ASCENDING) {
-			ent = xcontainer(elem, struct xhub_entry, lent);
-			invoke_direct(ent, val);
+		if (out) {
+			xlist_each(&outlist, elem, X_ASCENDING) {
+				xcontainer(elem, struct xhub_wait, link)->ent->ready_ns = now;
+			}
 		}
 	}
 
+	if (in) { invoke_waits(&inlist, val); }
+	if (out) { invoke_waits(&outlist, val); }
+
 	return 1;
 }
 
+#if HAS_IO_URING
+
+static void
+ring_complete(uint64_t udata, int32_t res, void *data)
+{
+	// cancellations and linked timeouts are submitted without user data
+	struct xhub_entry *ent = (struct xhub_entry *)(uintptr_t)udata;
+	if (ent != NULL) {
+		ent->ready_ns = *(int64_t *)data;
+		invoke_direct(ent, xint(res));
+	}
+}
+
+static int
+invoke_ring(struct xhub *hub)
+{
+	int64_t now = hub->account ? now_ns() : 0;
+	int rc = xpoll_reap(&hub->poll, false, ring_complete, &now);
+	return rc < 0 ? rc : 1;
+}
+
+#endif
+
 static int
 invoke_event(struct xhub *hub, struct xevent *ev)
 {
@@ -498,18 +1196,121 @@ invoke_event(struct xhub *hub, struct xevent *ev)
 	else if (ev->type & XPOLL_WAKE) {
 		return invoke_wake(hub);
 	}
+#if HAS_IO_URING
+	else if (ev->type & XPOLL_RING) {
+		return invoke_ring(hub);
+	}
+#endif
 	else {
 		return invoke_io(hub, ev);
 	}
 }
 
+/**
+ * @brief  Takes the next task from the immediate lists
+ *
+ * The highest class with tasks runs first. A class with a weight gives one
+ * turn to the next lower class waiting after that many turns in a row, so
+ * bulk work can't starve the classes below it entirely.
+ *
+ * @param  hub  hub pointer
+ * @return  entry to invoke or NULL
+ */
+static struct xhub_entry *
+next_immediate(struct xhub *hub)
+{
+	int p = -1;
+	for (int i = 0; i < XHUB_PRIOS; i++) {
+		if (xlist_is_empty(&hub->immediate[i])) { continue; }
+		if (p >= 0) {
+			p = i;
+			break;
+		}
+		p = i;
+		unsigned streak = hub->prio_last == i ? hub->prio_streak : 0;
+		if (hub->prio_weight[i] == 0 || streak < hub->prio_weight[i]) {
+			break;
+		}
+	}
+	if (p < 0) { return NULL; }
+
+	// only consecutive turns of the same class count toward its weight
+	if (p != hub->prio_last) {
+		hub->prio_last = p;
+		hub->prio_streak = 0;
+	}
+	hub->prio_streak++;
+
+	return xcontainer(xlist_first(&hub->immediate[p], X_ASCENDING),
+			struct xhub_entry, lent);
+}
+
+static void
+grow_spin(struct xhub *hub)
+{
+	hub->spin_ns *= 2;
+	if (hub->spin_ns > hub->spin_max_ns) { hub->spin_ns = hub->spin_max_ns; }
+}
+
+/**
+ * @brief  Waits for poll events, first spinning on the poll if enabled
+ *
+ * A spin that finds nothing halves the window, down to a sixteenth of the
+ * limit, and any event that arrives within the limit doubles it again.
+ *
+ * @param  hub  hub pointer
+ * @param  ns   nanoseconds until timeout, or -1 for infinite
+ * @param[out]  evs  events
+ * @param  n    maximum number of events
+ * @return  number of events, 0 on timeout, -errno on error
+ */
+static int
+poll_events(struct xhub *hub, int64_t ns, struct xevent *evs, int n)
+{
+	if (hub->spin_max_ns == 0 || ns == 0) {
+		return xpoll_waitv_ns(&hub->poll, ns, evs, n);
+	}
+
+	int64_t start = now_ns(), end = start + hub->spin_ns;
+	if (ns > 0 && ns < hub->spin_ns) {
+		end = start + ns;
+	}
+
+	int rc;
+	do {
+		rc = xpoll_waitv_ns(&hub->poll, 0, evs, n);
+		if (rc != 0) {
+			if (rc > 0) {
+				hub->stats.spin_hits++;
+				grow_spin(hub);
+			}
+			return rc;
+		}
+	} while (now_ns() < end);
+
+	hub->stats.spin_misses++;
+	hub->spin_ns /= 2;
+	if (hub->spin_ns < hub->spin_max_ns / 16) { hub->spin_ns = hub->spin_max_ns / 16; }
+
+	if (ns > 0) {
+		ns -= now_ns() - start;
+		if (ns < 0) { ns = 0; }
+	}
+
+	// an event this soon would have been caught by a longer spin
+	rc = xpoll_waitv_ns(&hub->poll, ns, evs, n);
+	if (rc > 0 && now_ns() - start < hub->spin_max_ns) {
+		grow_spin(hub);
+	}
+	return rc;
+}
+
 static int
 run_once(struct xhub *hub)
 {
 	int rc;
-	int64_t ms = -1;
+	int64_t ns;
 	struct xlist *elem;
-	struct xheap_entry *wait;
 	struct xevent ev;
 	struct xhub_entry *ent;
 
@@ -520,40 +1321,54 @@ run_once(struct xhub *hub)
 	}
 
 	// then clear all immediate tasks
-	if ((elem = xlist_first(&hub->immediate, X_ASCENDING))) {
-		ent = xcontainer(elem, struct xhub_entry, lent);
+	if ((ent = next_immediate(hub))) {
 		return invoke_direct(ent, xzero);
 	}
 
-	// then check for a timeout period
-	if ((wait = xheap_get(&hub->timeout, XHEAP_ROOT))) {
-		// there is some task scheduled with a timeout to get its value to pass to the poll
-		ms = X_NSEC_TO_MSEC(wait->prio - XCLOCK_NSEC(&hub->poll.clock));
-		// if the timeout has already expired, immediately invoke it as a timeout
-		if (ms < 0) {
-			// TODO: should we give the task a 0-timeout poll if its scheduled for polling?
-			ent = xcontainer(wait, struct xhub_entry, hent);
-			return invoke_timeout(ent);
-		}
+	// pooled hubs pick up queued spawns or steal them from a busy sibling
+	if (hub->pool && (xhub_pool_drain(hub) > 0 || xhub_pool_steal(hub) > 0)) {
+		return 1;
 	}
-	// if there are no polled tasks then there is nothing to do
-	else if (xlist_is_empty(&hub->polled)) {
-		return 0;
+
+	// posts that arrived while tasks were running
+	if (has_posts(hub) && drain_posts(hub) > 0) {
+		return 1;
 	}
-	// if all polled tasks are deteched then invoke them as timed out
-	else if (hub->npolled == hub->ndetached) {
-		ent = xcontainer(xlist_first(&hub->polled, X_ASCENDING), struct xhub_entry, pent);
-		assert(ent->detached);
+
+	// if a timeout has already expired, immediately invoke it as a timeout
+	// TODO: should we give the task a 0-timeout poll if its scheduled for polling?
+	if ((ent = due_timer(hub))) {
 		return invoke_timeout(ent);
 	}
 
+	// then check for a timeout period to pass to the poll
+	if ((ns = next_timer(hub)) < 0) {
+		// if there are no polled tasks then there is nothing to do unless a
+		// sibling in the pool is still busy and may hand over more work
+		if (xlist_is_empty(&hub->polled)) {
+			if (hub->pool == NULL || !xhub_pool_active(hub->pool)) {
+				return 0;
+			}
+		}
+		// if all polled tasks are deteched then invoke them as timed out
+		else if (hub->npolled == hub->ndetached &&
+				(hub->pool == NULL || !xhub_pool_active(hub->pool))) {
+			ent = xcontainer(xlist_first(&hub->polled, X_ASCENDING), struct xhub_entry, pent);
+			assert(ent->detached);
+			return invoke_timeout(ent);
+		}
+	}
+
 	// we have some pollable tasks
-	rc = xpoll_wait(&hub->poll, ms, &ev);
+	rc = poll_events(hub, ns, &ev, 1);
 	switch (rc) {
 	case 0:
-		// there was a timeout so get the task with the earliest scheduled timeout
-		ent = xcontainer(wait, struct xhub_entry, hent);
-		return invoke_timeout(ent);
+		// there was a timeout so get the task with the earliest scheduled
+		// timeout, if the wheel wasn't just waiting to cascade a slot
+		if ((ent = due_timer(hub))) {
+			return invoke_timeout(ent);
+		}
+		return 1;
 	case 1:
 		// a pollable event occurred so extract the task to invoke
 		return invoke_event(hub, &ev);;
@@ -562,6 +1377,107 @@ run_once(struct xhub *hub)
 	}
 }
 
+static void
+record_batch(struct xhub *hub, unsigned n)
+{
+	int bucket = 31 - __builtin_clz(n);
+	if (bucket >= XHUB_BATCH_BUCKETS) { bucket = XHUB_BATCH_BUCKETS - 1; }
+
+	hub->stats.iterations++;
+	hub->stats.dispatched += n;
+	hub->stats.batch[bucket]++;
+	if (n > hub->stats.batch_max) { hub->stats.batch_max = n; }
+}
+
+static unsigned
+expire_timers(struct xhub *hub, unsigned n)
+{
+	struct xhub_entry *ent;
+
+	while (n < hub->batch && (ent = due_timer(hub))) {
+		invoke_timeout(ent);
+		n++;
+	}
+	return n;
+}
+
+static int
+run_batch(struct xhub *hub)
+{
+	int rc;
+	unsigned n = 0;
+	int64_t ns;
+	struct xlist *elem;
+	struct xhub_entry *ent;
+
+	// ready tasks go first just as in `run_once`, but up to the whole budget
+	while (n < hub->batch && (elem = xlist_first(&hub->closed, X_ASCENDING))) {
+		ent = xcontainer(elem, struct xhub_entry, lent);
+		invoke_direct(ent, xint(xerr_io(CLOSE)));
+		n++;
+	}
+	while (n < hub->batch && (ent = next_immediate(hub))) {
+		invoke_direct(ent, xzero);
+		n++;
+	}
+	if (n > 0) {
+		record_batch(hub, n);
+		return 1;
+	}
+
+	if (hub->pool && (xhub_pool_drain(hub) > 0 || xhub_pool_steal(hub) > 0)) {
+		return 1;
+	}
+
+	if (has_posts(hub) && drain_posts(hub) > 0) {
+		return 1;
+	}
+
+	// timers that expired while running tasks don't need to wait on the poll
+	if ((n = expire_timers(hub, 0)) > 0) {
+		record_batch(hub, n);
+		return 1;
+	}
+
+	if ((ns = next_timer(hub)) < 0) {
+		if (xlist_is_empty(&hub->polled)) {
+			if (hub->pool == NULL || !xhub_pool_active(hub->pool)) {
+				return 0;
+			}
+		}
+		else if (hub->npolled == hub->ndetached &&
+				(hub->pool == NULL || !xhub_pool_active(hub->pool))) {
+			ent = xcontainer(xlist_first(&hub->polled, X_ASCENDING), struct xhub_entry, pent);
+			assert(ent->detached);
+			return invoke_timeout(ent);
+		}
+	}
+
+	unsigned want = hub->batch - n;
+	if (want > XHUB_EVENTS) { want = XHUB_EVENTS; }
+
+	rc = poll_events(hub, ns, hub->events, (int)want);
+	if (rc < 0) { return rc; }
+
+	// tasks may close descriptors with events still to come, which clears
+	// their type so they are skipped
+	hub->epos = 0;
+	hub->elen = (unsigned)rc;
+	while (hub->epos < hub->elen) {
+		struct xevent *ev = &hub->events[hub->epos++];
+		if (ev->type != 0) {
+			invoke_event(hub, ev);
+			n++;
+		}
+	}
+
+	n = expire_timers(hub, n);
+	if (n > 0) {
+		record_batch(hub, n);
+	}
+	return 1;
+}
+
 int
 xhub_run(struct xhub *hub)
 {
@@ -569,15 +1485,21 @@ xhub_run(struct xhub *hub)
 		return xerr_sys(EPERM);
 	}
 
+	if (hub->pool && !atomic_load(&hub->pool->running)) {
+		return 0;
+	}
+
 	current_hub = hub;
 	hub->running = true;
 
 	int rc;
 	do {
-		rc = run_once(hub);
-	} while (hub->running && rc == 1);
+		rc = hub->batch > 1 ? run_batch(hub) : run_once(hub);
+	} while (hub->running && rc == 1 &&
+			(hub->pool == NULL || atomic_load(&hub->pool->running)));
 
 	hub->running = false;
+	hub->pool_done = hub->pool != NULL;
 	current_hub = NULL;
 
 	return rc;
@@ -586,35 +1508,179 @@ xhub_run(struct xhub *hub)
 int
 xhub_wake(struct xhub *hub)
 {
+	atomic_store(&hub->woken, true);
 	return xpoll_wake(&hub->poll);
 }
 
+void
+xhub_poke(struct xhub *hub)
+{
+	xpoll_wake(&hub->poll);
+}
+
 void
 xhub_stop(struct xhub *hub)
 {
-	hub->running = false;
+	if (hub->pool) {
+		xhub_pool_stop(hub->pool);
+	}
+	else {
+		hub->running = false;
+	}
+}
+
+void
+xhub_set_batch(struct xhub *hub, unsigned budget)
+{
+	assert(hub != NULL);
+
+	hub->batch = budget > 1 ? budget : 1;
+
+	// let one wait return as many events as a pass may dispatch
+	unsigned events = hub->batch < XHUB_EVENTS ? hub->batch : XHUB_EVENTS;
+	if (events > XPOLL_BATCH) {
+		xpoll_set_batch(&hub->poll, events);
+	}
+}
+
+int
+xhub_set_prio_weight(struct xhub *hub, int prio, unsigned weight)
+{
+	assert(hub != NULL);
+
+	if (prio < 0 || prio >= XHUB_PRIOS) {
+		return xerr_sys(EINVAL);
+	}
+	hub->prio_weight[prio] = weight;
+	return 0;
+}
+
+void
+xhub_set_io_budget(struct xhub *hub, unsigned calls, unsigned usec)
+{
+	assert(hub != NULL);
+
+	hub->io_budget = calls;
+	hub->io_budget_ns = X_USEC_TO_NSEC((int64_t)usec);
+}
+
+void
+xhub_set_busy_poll(struct xhub *hub, unsigned usec, bool sockopt)
+{
+	assert(hub != NULL);
+
+	hub->spin_max_ns = X_USEC_TO_NSEC((int64_t)usec);
+	hub->spin_ns = hub->spin_max_ns;
+	hub->spin_sockopt = usec > 0 && sockopt;
+}
+
+void
+xhub_set_ring(struct xhub *hub, bool enable)
+{
+	assert(hub != NULL);
+
+	hub->ring = enable;
+}
+
+void
+xhub_stats(const struct xhub *hub, struct xhub_stats *stats)
+{
+	assert(hub != NULL);
+	assert(stats != NULL);
+
+	*stats = hub->stats;
+}
+
+void
+xhub_account(struct xhub *hub, bool enable)
+{
+	assert(hub != NULL);
+
+	hub->account = enable;
+}
+
+int
+xhub_sites(const struct xhub *hub, struct xhub_site *sites, int nsites)
+{
+	assert(hub != NULL);
+	assert(sites != NULL || nsites == 0);
+
+	int n = 0;
+	for (const struct xhub_site_node *node = hub->sites; node; node = node->next) {
+		if (n < nsites) { sites[n] = node->site; }
+		n++;
+	}
+	return n;
+}
+
+struct xmgr *
+xhub_mgr(struct xhub *hub)
+{
+	assert(hub != NULL);
+
+	return &hub->mgr;
 }
 
 void
 xhub_remove_io(struct xhub *hub, int fd)
 {
-	struct xhub_io *io = get_io(hub, fd);
+	struct xhub_io *io = find_io(hub, fd);
 	struct xlist *elem;
-	struct xhub_entry *ent;
 
-	xlist_each(&io->in, elem, X_ASCENDING) {
-		ent = xcontainer(elem, struct xhub_entry, lent);
-		mark_closed(ent);
+	// nothing has ever been scheduled for the descriptor
+	if (io == NULL) {
+		return;
 	}
 
-	xlist_each(&io->out, elem, X_ASCENDING) {
-		ent = xcontainer(elem, struct xhub_entry, lent);
-		mark_closed(ent);
+	while ((elem = xlist_first(&io->in, X_ASCENDING))) {
+		mark_closed(xcontainer(elem, struct xhub_wait, link));
+	}
+
+	while ((elem = xlist_first(&io->out, X_ASCENDING))) {
+		mark_closed(xcontainer(elem, struct xhub_wait, link));
+	}
+
+#if HAS_IO_URING
+	// operations in the ring hold their own reference to the file, so they
+	// are cancelled and the tasks resume once the kernel lets go of them
+	xlist_each(&io->ring, elem, X_ASCENDING) {
+		struct xhub_entry *ent = xcontainer(elem, struct xhub_entry, lent);
+		if (!ent->ring_closed && xpoll_cancel(&hub->poll, (uintptr_t)ent) == 0) {
+			ent->ring_closed = true;
+		}
 	}
+#endif
 
 	if (xpoll_ctl(&hub->poll, fd, io->type, XPOLL_NONE) == 0) {
 		io->type = XPOLL_NONE;
 	}
+	for (unsigned i = hub->epos; i < hub->elen; i++) {
+		if (hub->events[i].id == fd && (hub->events[i].type & XPOLL_INOUT)) {
+			hub->events[i].type = 0;
+		}
+	}
+	io->readable = true;
+	io->stream = -1;
+	io->busy_poll = false;
+}
+
+static void
+print_went(struct xwheel_entry *went, void *data)
+{
+	struct xhub_entry *ent = xcontainer(went, struct xhub_entry, went);
+	xtask_print_val(ent->t, data, 2);
+	fprintf(data, "\n");
+}
+
+static void
+print_times(FILE *out, const char *name, const uint64_t *buckets)
+{
+	for (int i = 0; i < XHUB_TIME_BUCKETS; i++) {
+		if (buckets[i]) {
+			fprintf(out, "  %s/%" PRIu64 " = %" PRIu64 "\n",
+					name, UINT64_C(1) << i, buckets[i]);
+		}
+	}
 }
 
 void
@@ -637,7 +1703,9 @@ xhub_print(struct xhub *hub, FILE *out)
 		struct xlist *list;
 	} lists[] = {
 		{ "closed", &hub->closed },
-		{ "immediate", &hub->immediate },
+		{ "immediate/high", &hub->immediate[XHUB_PRIO_HIGH] },
+		{ "immediate", &hub->immediate[XHUB_PRIO_NORMAL] },
+		{ "immediate/low", &hub->immediate[XHUB_PRIO_LOW] },
 		{ "wake", &hub->wake },
 	};
 
@@ -662,8 +1730,9 @@ xhub_print(struct xhub *hub, FILE *out)
 		}
 	}
 
-	if (xheap_count(&hub->timeout)) {
+	if (hub->wheel.count || xheap_count(&hub->timeout)) {
 		fprintf(out, "  timeout = {\n");
+		xwheel_each(&hub->wheel, print_went, out);
 		uint32_t n = xheap_count(&hub->timeout);
 		for (uint32_t i = XHEAP_ROOT; i <= n; i++) {
 			h = xheap_get(&hub->timeout, i);
@@ -674,33 +1743,47 @@ xhub_print(struct xhub *hub, FILE *out)
 		fprintf(out, "  }\n");
 	}
 
-	io = hub->io;
-	for (int i = 0; i < hub->maxfd; i++, io++) {
+	for (int i = 0; i < (int)hub->npages * XHUB_IO_PAGE; i++) {
+		if ((io = find_io(hub, i)) == NULL) {
+			i += XHUB_IO_PAGE - 1;
+			continue;
+		}
 		if (!xlist_is_empty(&io->in)) {
 			fprintf(out, "  #%d/in = {\n", i);
 			xlist_each(&io->in, elem, X_ASCENDING) {
-				ent = xcontainer(elem, struct xhub_entry, lent);
+				ent = xcontainer(elem, struct xhub_wait, link)->ent;
 				xtask_print_val(ent->t, out, 2);
 				fprintf(out, "\n");
 			}
 			fprintf(out, "  }\n");
 		}
 		if (!xlist_is_empty(&io->out)) {
-			fprintf(out, "  #%d/in = {\n", i);
+			fprintf(out, "  #%d/out = {\n", i);
 			xlist_each(&io->out, elem, X_ASCENDING) {
+				ent = xcontainer(elem, struct xhub_wait, link)->ent;
+				xtask_print_val(ent->t, out, 2);
+				fprintf(out, "\n");
+			}
+			fprintf(out, "  }\n");
+		}
+#if HAS_IO_URING
+		if (!xlist_is_empty(&io->ring)) {
+			fprintf(out, "  #%d/ring = {\n", i);
+			xlist_each(&io->ring, elem, X_ASCENDING) {
 				ent = xcontainer(elem, struct xhub_entry, lent);
 				xtask_print_val(ent->t, out, 2);
 				fprintf(out, "\n");
 			}
 			fprintf(out, "  }\n");
 		}
+#endif
 	}
 
 	for (size_t i = 0; i < xlen(hub->sig); i++) {
 		if (!xlist_is_empty(&hub->sig[i])) {
 			fprintf(out, "  %s {\n", signame[i+1]);
 			xlist_each(&hub->sig[i], elem, X_ASCENDING) {
-				ent = xcontainer(elem, struct xhub_entry, lent);
+				ent = xcontainer(elem, struct xhub_wait, link)->ent;
 				xtask_print_val(ent->t, out, 2);
 				fprintf(out, "\n");
 			}
@@ -708,6 +1791,61 @@ xhub_print(struct xhub *hub, FILE *out)
 		}
 	}
 
+	if (hub->stats.iterations) {
+		fprintf(out, "  batch = { budget = %u, iterations = %" PRIu64
+				", dispatched = %" PRIu64 ", max = %u }\n",
+				hub->batch, hub->stats.iterations,
+				hub->stats.dispatched, hub->stats.batch_max);
+		for (int i = 0; i < XHUB_BATCH_BUCKETS; i++) {
+			if (hub->stats.batch[i]) {
+				fprintf(out, "  batch/%u = %" PRIu64 "\n",
+						1u << i, hub->stats.batch[i]);
+			}
+		}
+	}
+
+	if (hub->stats.posted) {
+		fprintf(out, "  post = { posted = %" PRIu64 ", drains = %" PRIu64 " }\n",
+				hub->stats.posted, hub->stats.post_drains);
+	}
+
+	if (hub->stats.reads_saved) {
+		fprintf(out, "  reads_saved = %" PRIu64 "\n", hub->stats.reads_saved);
+	}
+
+	if (hub->stats.forced_yields) {
+		fprintf(out, "  forced_yields = %" PRIu64 "\n", hub->stats.forced_yields);
+	}
+
+	if (hub->spin_max_ns) {
+		fprintf(out, "  spin = { window = %" PRId64 ", hits = %" PRIu64
+				", misses = %" PRIu64 " }\n",
+				hub->spin_ns, hub->stats.spin_hits, hub->stats.spin_misses);
+	}
+
+	if (hub->stats.resumed) {
+		uint64_t n = hub->stats.resumed;
+		fprintf(out, "  sched = { resumed = %" PRIu64
+				", wait_mean = %" PRIu64 ", wait_max = %" PRIu64
+				", run_mean = %" PRIu64 ", run_max = %" PRIu64 " }\n",
+				n, hub->stats.wait_ns / n, hub->stats.wait_max,
+				hub->stats.run_ns / n, hub->stats.run_max);
+		print_times(out, "wait", hub->stats.wait);
+		print_times(out, "run", hub->stats.run);
+	}
+
+	for (const struct xhub_site_node *node = hub->sites; node; node = node->next) {
+		const struct xhub_site *site = &node->site;
+		if (site->tasks == 0) { continue; }
+		fprintf(out, "  cpu = { site = %s:%d, tasks = %" PRIu64
+				", mean = %" PRIu64 ", max = %" PRIu64 " }\n",
+				site->file ? site->file : "?", site->line, site->tasks,
+				site->cpu_ns / site->tasks, site->cpu_max);
+		print_times(out, "cpu", site->cpu);
+	}
+
+	xmgr_print_stacks(&hub->mgr, out, 1);
+
 	fprintf(out, "}\n");
 }
 
@@ -721,30 +1859,128 @@ spawn_fn(void *tls, union xvalue val)
 }
 
 int
-xspawnf(struct xhub *hub, const char *file, int line,
-		void (*fn)(struct xhub *, union xvalue), union xvalue val)
+xhub_spawn_local(struct xhub *hub, const struct xhub_spawn *req, bool counted)
 {
 	struct xtask *t;
 	struct xhub_entry *ent;
-	int rc = xtask_newf(&t, &hub->mgr, NULL, file, line, spawn_fn);
+	int rc = xtask_newf(&t, &hub->mgr, NULL, req->file, req->line, spawn_fn);
 	if (rc < 0) {
 		return rc;
 	}
 
 #ifndef NDEBUG
-	xtask_record_entry(t, (void *)fn);
+	xtask_record_entry(t, (void *)req->fn);
 #endif
 
 	ent = xtask_local(t);
-	ent->magic = MAGIC;
+	ent->magic = XHUB_MAGIC;
 	ent->t = t;
-	ent->vinit = val;
+	ent->vinit = req->val;
 	ent->hub = hub;
-	ent->fn = fn;
+	ent->fn = req->fn;
+	ent->ready_ns = 0;
+	ent->run_ns = 0;
+	ent->cpu_ns = 0;
+	ent->cancelled = false;
+	ent->interrupted = false;
+	ent->deadline = req->deadline;
+	ent->prio = (uint8_t)req->prio;
+	ent->io_calls = 0;
+	ent->io_start = 0;
+	ent->group = req->group;
+	ent->group_fn = req->group_fn;
+	ent->group_rc = 0;
+	if (ent->group) {
+		xgroup_add(ent->group, ent);
+	}
+	ent->site = hub->account ? find_site(hub, req->file, req->line) : NULL;
+
+	if (!counted) {
+		atomic_fetch_add(&hub->nload, 1);
+		if (hub->pool) { xhub_pool_busy(hub->pool, 1); }
+	}
 
 	return schedule_immediate(ent);
 }
 
+int
+xhub_postf(struct xhub *hub, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val)
+{
+	assert(hub != NULL);
+
+	struct xhub_post *post = malloc(sizeof(*post));
+	if (post == NULL) {
+		return xerrno;
+	}
+	post->req = (struct xhub_spawn) {
+		.fn = fn,
+		.val = val,
+		.file = file,
+		.line = line,
+	};
+	xhub_inherit(&post->req);
+
+	// count the task now so a pool doesn't finish while it is queued
+	atomic_fetch_add(&hub->nload, 1);
+	if (hub->pool) { xhub_pool_busy(hub->pool, 1); }
+
+	xhub_post_push(hub, post);
+	return 0;
+}
+
+void
+xhub_post_push(struct xhub *hub, struct xhub_post *post)
+{
+	post_push(hub, post);
+
+	// only the first post since the last drain pays for the eventfd write
+	if (!atomic_exchange(&hub->post_wake, true)) {
+		xhub_poke(hub);
+	}
+}
+
+int
+xspawnf(struct xhub *hub, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val)
+{
+	if (hub->pool) {
+		return xhub_pool_spawnf(hub->pool, -1, file, line, fn, val);
+	}
+
+	struct xhub_spawn req = {
+		.fn = fn,
+		.val = val,
+		.file = file,
+		.line = line,
+	};
+	xhub_inherit(&req);
+	return xhub_spawn_local(hub, &req, false);
+}
+
+int
+xspawnf_prio(struct xhub *hub, int prio, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val)
+{
+	if (prio < 0 || prio >= XHUB_PRIOS) {
+		return xerr_sys(EINVAL);
+	}
+
+	struct xhub_spawn req = {
+		.fn = fn,
+		.val = val,
+		.file = file,
+		.line = line,
+	};
+	xhub_inherit(&req);
+	req.prio = prio;
+
+	if (hub->pool) {
+		return xhub_pool_submit(hub->pool, -1, &req);
+	}
+	return xhub_spawn_local(hub, &req, false);
+}
+
 #if defined(__BLOCKS__)
 
 #include <Block.h>
@@ -771,35 +2007,171 @@ xspawn_b(struct xhub *hub, void (^block)(void))
 
 #endif
 
+struct xhub *
+xhub_current(void)
+{
+	return current_hub;
+}
+
+void
+xhub_inherit(struct xhub_spawn *req)
+{
+	struct xhub_entry *ent = current_entry;
+	req->deadline = ent ? ent->deadline : 0;
+	req->prio = ent ? ent->prio : XHUB_PRIO_NORMAL;
+}
+
 const struct timespec *
 xclock(void)
 {
 	return current_hub ? &current_hub->poll.clock : NULL;
 }
 
+uint64_t
+xcputime(void)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return 0; }
+	if (!ent->hub->account || ent->run_ns == 0) { return ent->cpu_ns; }
+	return ent->cpu_ns + (uint64_t)(now_ns() - ent->run_ns);
+}
+
+/**
+ * @brief  Suspends the current task for a time, or until its deadline
+ *
+ * @param  ent  entry of the current task
+ * @param  ns   nanoseconds to sleep
+ * @return  0 on success, -ETIMEDOUT if the deadline cut it short, or
+ *          -ECANCELED
+ */
+static int
+sleep_task(struct xhub_entry *ent, int64_t ns)
+{
+	if (ent->cancelled) {
+		return xerr_sys(ECANCELED);
+	}
+
+	int64_t deadline;
+	int rc = wait_deadline(ent, ns, &deadline);
+	if (rc < 0) {
+		return rc;
+	}
+
+	rc = schedule_timeout(ent, deadline);
+	if (rc == 0) {
+		rc = yield_wait(ent);
+		if (rc == 0 && deadline == ent->deadline) { rc = xerr_sys(ETIMEDOUT); }
+	}
+	return rc;
+}
+
 int
 xwait(int fd, int polltype, int timeoutms)
+{
+	return xwait_ns(fd, polltype, ms_timeout(timeoutms));
+}
+
+int
+xwait_ns(int fd, int polltype, int64_t timeoutns)
 {
 	struct xhub_entry *ent = current_entry;
 	if (ent == NULL) { return xerr_sys(EAGAIN); }
 
 	int rc;
 	if (polltype > 0) {
-		rc = schedule_poll(ent, fd, polltype, timeoutms);
+		rc = schedule_poll(ent, fd, polltype, NULL, timeoutns);
 	}
-	else if (timeoutms >= 0) {
-		rc = schedule_timeout(ent, timeoutms);
+	else if (timeoutns >= 0) {
+		return sleep_task(ent, timeoutns);
 	}
 	else {
 		rc = schedule_immediate(ent);
 	}
 
 	if (rc == 0) {
-		rc = xyield(xzero).i;
+		rc = yield_wait(ent);
+	}
+	return rc;
+}
+
+int
+xhub_park(struct xlist *list, void *data, int timeoutms)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return xerr_sys(EPERM); }
+
+	ent->park = list;
+	ent->park_rc = 0;
+
+	int rc = schedule_poll(ent, -1, XPOLL_PARK, data, ms_timeout(timeoutms));
+	if (rc == 0) {
+		rc = yield_wait(ent);
+		if (rc == 0) { rc = ent->park_rc; }
 	}
 	return rc;
 }
 
+void
+xhub_unpark(struct xhub_wait *w, int rc)
+{
+	struct xhub_entry *ent = w->ent;
+	assert(ent->poll_type == XPOLL_PARK || ent->poll_type == XPOLL_SELECT);
+
+	ent->wait_idx = w->idx;
+	unschedule(ent);
+	ent->park_rc = rc;
+	schedule_immediate(ent);
+}
+
+int
+xselect(struct xselect *ops, int nops, int timeoutms)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return xerr_sys(EPERM); }
+	if (ops == NULL || nops <= 0) { return xerr_sys(EINVAL); }
+
+	// channel operations that can complete now win in order
+	for (int i = 0; i < nops; i++) {
+		if (ops[i].type == XSELECT_SEND || ops[i].type == XSELECT_RECV) {
+			int rc = xchan_try(ops[i].chan, ops[i].type == XSELECT_SEND, ops[i].msg);
+			if (rc != xerr_sys(EAGAIN)) {
+				ops[i].rc = rc;
+				return i;
+			}
+		}
+	}
+
+	// the nodes stay on this stack until the task is resumed
+	struct xhub_wait waits[nops];
+	for (int i = 0; i < nops; i++) {
+		waits[i] = (struct xhub_wait) {
+			.ent = ent,
+			.data = ops[i].msg,
+			.idx = i,
+		};
+	}
+	ent->waits = waits;
+	ent->nwaits = nops;
+	ent->park_rc = 0;
+
+	int rc = schedule_poll(ent, -1, XPOLL_SELECT, ops, ms_timeout(timeoutms));
+	if (rc < 0) {
+		return rc;
+	}
+
+	rc = yield_wait(ent);
+	int idx = ent->wait_idx;
+	if (idx < 0) {
+		return rc;
+	}
+
+	if (ops[idx].type == XSELECT_SEND || ops[idx].type == XSELECT_RECV) {
+		rc = ent->park_rc;
+	}
+	ops[idx].rc = rc;
+	return idx;
+}
+
 int
 xsleep(unsigned ms)
 {
@@ -814,11 +2186,26 @@ xsleep(unsigned ms)
 		return rc;
 	}
 
-	int rc = schedule_timeout(ent, ms);
-	if (rc == 0) {
-		xyield(xzero);
+	return sleep_task(ent, X_MSEC_TO_NSEC((int64_t)ms));
+}
+
+int
+xsleep_ns(uint64_t ns)
+{
+	if (ns > INT64_MAX) { ns = INT64_MAX; }
+
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) {
+		struct timespec c = XCLOCK_MAKE_NSEC((int64_t)ns);
+		int rc;
+		do {
+			rc = nanosleep(&c, &c);
+			if (rc < 0) { rc = xerrno; }
+		} while (rc == xerr_sys(EINTR));
+		return rc;
 	}
-	return rc;
+
+	return sleep_task(ent, (int64_t)ns);
 }
 
 void
@@ -827,7 +2214,7 @@ xexit(int ec)
 	struct xtask *t = xtask_self();
 	if (t == NULL) { exit(ec); }
 	struct xhub_entry *ent = xtask_local(t);
-	if (ent && ent->magic == MAGIC) { unschedule(ent); }
+	if (ent && ent->magic == XHUB_MAGIC) { unschedule(ent); }
 	xtask_exit(t, ec);
 }
 
@@ -843,48 +2230,323 @@ xabort(void)
 	struct xtask *t = xtask_self();
 	if (t == NULL) { abort(); }
 	struct xhub_entry *ent = xtask_local(t);
-	if (ent && ent->magic == MAGIC) { unschedule(ent); }
+	if (ent && ent->magic == XHUB_MAGIC) { unschedule(ent); }
 	xtask_print(t, stderr);
 	xtask_exit(t, SIGABRT);
 }
 
+int
+xtask_cancel(struct xtask *t)
+{
+	assert(t != NULL);
+
+	struct xhub_entry *ent = xtask_local(t);
+	if (ent == NULL || ent->magic != XHUB_MAGIC || !xtask_alive(t)) {
+		return xerr_sys(EINVAL);
+	}
+	if (current_hub != ent->hub) {
+		return xerr_sys(EXDEV);
+	}
+	if (ent->cancelled) {
+		return xerr_sys(EALREADY);
+	}
+
+	ent->cancelled = true;
+
+#if HAS_IO_URING
+	// the kernel may use the task's buffers until the operation completes
+	if (ent->poll_type == XPOLL_RING) {
+		int rc = xpoll_cancel(&ent->hub->poll, (uintptr_t)ent);
+		if (rc < 0) {
+			ent->cancelled = false;
+		}
+		return rc;
+	}
+#endif
+
+	// a runnable task fails its next wait instead
+	if (ent->poll_type != XPOLL_NONE || has_timer(ent)) {
+		unschedule(ent);
+		ent->interrupted = true;
+		schedule_immediate(ent);
+	}
+	return 0;
+}
+
+static int
+enter_scope(struct xscope *scope, int64_t deadline)
+{
+	assert(scope != NULL);
+
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return xerr_sys(EPERM); }
+
+	// an inner scope may only bring the deadline closer
+	scope->prev = ent->deadline;
+	if (deadline != 0 && (ent->deadline == 0 || deadline < ent->deadline)) {
+		ent->deadline = deadline;
+	}
+	return 0;
+}
+
+int
+xscope_enter(struct xscope *scope, int timeoutms)
+{
+	// whole milliseconds keep the waits in the scope on the timer wheel
+	int64_t deadline = 0;
+	if (timeoutms >= 0) {
+		deadline = round_ms(now_ns() + X_MSEC_TO_NSEC((int64_t)timeoutms));
+	}
+	return enter_scope(scope, deadline);
+}
+
+int
+xscope_enter_ns(struct xscope *scope, int64_t timeoutns)
+{
+	return enter_scope(scope, timeoutns >= 0 ? now_ns() + timeoutns : 0);
+}
+
+void
+xscope_exit(const struct xscope *scope)
+{
+	assert(scope != NULL);
+
+	struct xhub_entry *ent = current_entry;
+	if (ent != NULL) {
+		ent->deadline = scope->prev;
+	}
+}
+
+int
+xscope_remaining(void)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL || ent->deadline == 0) { return XTIMEOUT_NONE; }
+
+	// rounded up so a wait using it doesn't end just short of the deadline
+	int64_t left = ent->deadline - now_ns();
+	if (left <= 0) { return 0; }
+	int64_t ms = (left + X_NSEC_PER_MSEC - 1) / X_NSEC_PER_MSEC;
+	return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
 int
 xsignal(int signum, int timeoutms)
 {
 	struct xhub_entry *ent = current_entry;
 	if (ent == NULL) { return xerr_sys(EPERM); }
-	int rc = schedule_poll(ent, signum, XPOLL_SIG, timeoutms);
+	int rc = schedule_poll(ent, signum, XPOLL_SIG, NULL, ms_timeout(timeoutms));
 	if (rc == 0) {
-		int val = xyield(xzero).i;
+		int val = yield_wait(ent);
 		return val ? val : signum;
 	}
 	return rc;
 }
 
-#define RECV_LOOP(fd, ms, fn, ...) for (;;) { \
-	ssize_t rc = fn(fd, __VA_ARGS__); \
-	if (rc >= 0) { return rc; } \
-	rc = xerrno; \
-	if (rc != xerr_sys(EAGAIN)) { return rc; } \
+#if HAS_IO_URING
+
+ssize_t
+xhub_ring(const struct io_uring_sqe *op, int timeoutms)
+{
+	// cancelled and expired tasks fall back so that only the wait fails
+	struct xhub_entry *ent = current_entry;
+	int64_t deadline;
+	if (ent == NULL || timeoutms == XTIMEOUT_DETACH || ent->cancelled ||
+			wait_deadline(ent, ms_timeout(timeoutms), &deadline) < 0 ||
+			!ent->hub->ring || !xpoll_has_ring(&ent->hub->poll)) {
+		return xerr_sys(EAGAIN);
+	}
+
+	struct xhub *hub = ent->hub;
+	struct xhub_io *io;
+	if (get_io(hub, op->fd, &io) < 0) {
+		return xerr_sys(EAGAIN);
+	}
+	set_busy_poll(hub, op->fd, io);
+
+	struct io_uring_sqe *sqe = xpoll_sqe(&hub->poll, deadline != 0 ? 2 : 1);
+	if (sqe == NULL) {
+		return xerr_sys(EAGAIN);
+	}
+
+	*sqe = *op;
+	sqe->user_data = (uintptr_t)ent;
+
+	if (deadline != 0) {
+		int64_t left = deadline - XCLOCK_NSEC(&hub->poll.clock);
+		if (left < 0) { left = 0; }
+		ent->ring_ts.tv_sec = left / X_NSEC_PER_SEC;
+		ent->ring_ts.tv_nsec = left % X_NSEC_PER_SEC;
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = xpoll_sqe(&hub->poll, 1);
+		sqe->opcode = IORING_OP_LINK_TIMEOUT;
+		sqe->fd = -1;
+		sqe->addr = (uintptr_t)&ent->ring_ts;
+		sqe->len = 1;
+	}
+
+	// park the task until the completion resumes it
+	ent->ring_closed = false;
+	ent->hent.key = XHEAP_NONE;
+	ent->detached = false;
+	ent->poll_id = op->fd;
+	ent->poll_type = XPOLL_RING;
+	xlist_add(&io->ring, &ent->lent, X_ASCENDING);
+	xlist_add(&hub->polled, &ent->pent, X_ASCENDING);
+	hub->npolled++;
+
+	int res = xyield(xzero).i;
+	if (res == xerr_sys(ECANCELED) && !ent->cancelled) {
+		res = ent->ring_closed ? xerr_io(CLOSE) : xerr_sys(ETIMEDOUT);
+	}
+	return res;
+}
+
+static inline uint32_t
+ring_len(size_t len)
+{
+	return len > UINT32_MAX ? UINT32_MAX : (uint32_t)len;
+}
+
+// completes the call through the ring unless it asks for a readiness wait
+#define RING_CALL(ms, ...) do { \
+	ssize_t rrc = xhub_ring(&(struct io_uring_sqe){ __VA_ARGS__ }, ms); \
+	if (rrc != xerr_sys(EAGAIN)) { return rrc == xerr_io(CLOSE) ? 0 : rrc; } \
+} while (0)
+
+#else
+
+#define RING_CALL(ms, ...)
+
+#endif
+
+/**
+ * @brief  Checks if a short read left the descriptor without data
+ *
+ * A read on a stream that returns less than was asked for has emptied the
+ * kernel's buffer, so with edge-triggered polling the next read would only
+ * fail with EAGAIN. The descriptor is readable again on its next edge. Reads
+ * completed through the ring never see EAGAIN and skip this tracking.
+ *
+ * @param  fd  file descriptor
+ * @return  true if the read can wait without trying first
+ */
+static bool
+read_drained(int fd)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return false; }
+
+	struct xhub_io *io = find_io(ent->hub, fd);
+	if (io == NULL || io->readable || !(io->type & XPOLL_IN)) {
+		return false;
+	}
+	ent->hub->stats.reads_saved++;
+	return true;
+}
+
+/**
+ * @brief  Marks a stream not readable after a short read
+ *
+ * Datagrams and terminals return less than was asked for while more is
+ * queued, so only stream sockets and pipes are tracked. The descriptor must
+ * already be registered for input, or no edge would follow.
+ *
+ * @param  fd    file descriptor
+ * @param  rc    bytes read
+ * @param  want  bytes asked for, or 0 if the read doesn't consume
+ */
+static void
+read_short(int fd, ssize_t rc, size_t want)
+{
+	struct xhub_entry *ent = current_entry;
+	if (rc <= 0 || (size_t)rc >= want || ent == NULL) { return; }
+
+	struct xhub_io *io = find_io(ent->hub, fd);
+	if (io == NULL || !(io->type & XPOLL_IN)) { return; }
+
+	if (io->stream < 0) {
+		int type;
+		socklen_t len = sizeof(type);
+		struct stat st;
+		if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0) {
+			io->stream = type == SOCK_STREAM;
+		}
+		else {
+			io->stream = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+		}
+	}
+	if (io->stream) {
+		io->readable = false;
+	}
+}
+
+/**
+ * @brief  Charges an I/O call that completed without waiting to the task
+ *
+ * A descriptor that is always ready never makes its task wait, so once the
+ * task has used up the hub's budget of calls or time since it was resumed,
+ * it is put at the back of its immediate list to let other tasks run.
+ */
+static void
+charge_io(void)
+{
+	struct xhub_entry *ent = current_entry;
+	if (ent == NULL) { return; }
+
+	struct xhub *hub = ent->hub;
+	bool spent = hub->io_budget > 0 && ++ent->io_calls >= hub->io_budget;
+	if (!spent && hub->io_budget_ns > 0) {
+		int64_t now = now_ns();
+		if (ent->io_start == 0) { ent->io_start = now; }
+		spent = now - ent->io_start >= hub->io_budget_ns;
+	}
+
+	if (spent) {
+		hub->stats.forced_yields++;
+		schedule_immediate(ent);
+		xyield(xzero);
+	}
+}
+
+static size_t
+iov_len(const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+	return len;
+}
+
+#define RECV_LOOP(fd, ms, want, fn, ...) \
+	for (bool wait = read_drained(fd); ; wait = false) { \
+	ssize_t rc = xerr_sys(EAGAIN); \
+	if (!wait) { \
+		rc = fn(fd, __VA_ARGS__); \
+		if (rc >= 0) { read_short(fd, rc, want); charge_io(); return rc; } \
+		rc = xerrno; \
+		if (rc != xerr_sys(EAGAIN)) { return rc; } \
+	} \
 	struct xhub_entry *ent = current_entry; \
 	if (ent == NULL) { return rc; } \
-	rc = schedule_poll(ent, fd, XPOLL_IN, ms); \
+	rc = schedule_poll(ent, fd, XPOLL_IN, NULL, ms_timeout(ms)); \
 	if (rc < 0) { return rc; } \
-	int val = xyield(xzero).i; \
+	int val = yield_wait(ent); \
 	if (val == xerr_io(CLOSE)) { return 0; } \
 	if (val < 0) { return (ssize_t)val; } \
 }
 
 #define SEND_LOOP(fd, ms, fn, ...) for (;;) { \
 	ssize_t rc = fn(fd, __VA_ARGS__); \
-	if (rc >= 0) { return rc; } \
+	if (rc >= 0) { charge_io(); return rc; } \
 	rc = xerrno; \
 	if (rc != xerr_sys(EAGAIN)) { return rc; } \
 	struct xhub_entry *ent = current_entry; \
 	if (ent == NULL) { return rc; } \
-	rc = schedule_poll(ent, fd, XPOLL_OUT, ms); \
+	rc = schedule_poll(ent, fd, XPOLL_OUT, NULL, ms_timeout(ms)); \
 	if (rc < 0) { return rc; } \
-	int val = xyield(xzero).i; \
+	int val = yield_wait(ent); \
 	if (val == xerr_io(CLOSE)) { return 0; } \
 	if (val < 0) { return (ssize_t)val; } \
 }
@@ -892,26 +2554,50 @@ xsignal(int signum, int timeoutms)
 ssize_t
 xread(int fd, void *buf, size_t len, int timeoutms)
 {
-	RECV_LOOP(fd, timeoutms, read, buf, len);
+	RING_CALL(timeoutms, .opcode = IORING_OP_READ, .fd = fd,
+			.addr = (uintptr_t)buf, .len = ring_len(len), .off = -1);
+	RECV_LOOP(fd, timeoutms, len, read, buf, len);
 }
 
 ssize_t
 xreadv(int fd, struct iovec *iov, int iovcnt, int timeoutms)
 {
-	RECV_LOOP(fd, timeoutms, readv, iov, iovcnt);
+	RING_CALL(timeoutms, .opcode = IORING_OP_READV, .fd = fd,
+			.addr = (uintptr_t)iov, .len = iovcnt, .off = -1);
+	RECV_LOOP(fd, timeoutms, iov_len(iov, iovcnt), readv, iov, iovcnt);
 }
 
 ssize_t
 xrecv(int fd, void *buf, size_t len, int flags, int timeoutms)
 {
-	RECV_LOOP(fd, timeoutms, recv, buf, flags, len);
+	RING_CALL(timeoutms, .opcode = IORING_OP_RECV, .fd = fd,
+			.addr = (uintptr_t)buf, .len = ring_len(len), .msg_flags = flags);
+	RECV_LOOP(fd, timeoutms, (flags & MSG_PEEK) ? 0 : len, recv, buf, len, flags);
 }
 
 ssize_t
 xrecvfrom(int s, void *buf, size_t len, int flags,
 	 struct sockaddr *src_addr, socklen_t *src_len, int timeoutms)
 {
-	RECV_LOOP(s, timeoutms, recvfrom, buf, len, flags, src_addr, src_len);
+#if HAS_IO_URING
+	struct iovec iov = { buf, len };
+	struct msghdr msg = {
+		.msg_name = src_addr,
+		.msg_namelen = src_len ? *src_len : 0,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	ssize_t rc = xhub_ring(&(struct io_uring_sqe){
+			.opcode = IORING_OP_RECVMSG, .fd = s,
+			.addr = (uintptr_t)&msg, .len = 1, .msg_flags = flags
+		}, timeoutms);
+	if (rc != xerr_sys(EAGAIN)) {
+		if (rc >= 0 && src_len) { *src_len = msg.msg_namelen; }
+		return rc == xerr_io(CLOSE) ? 0 : rc;
+	}
+#endif
+	RECV_LOOP(s, timeoutms, (flags & MSG_PEEK) ? 0 : len,
+			recvfrom, buf, len, flags, src_addr, src_len);
 }
 
 ssize_t
@@ -923,18 +2609,24 @@ xreadn(int fd, void *buf, size_t len, int timeoutms)
 ssize_t
 xwrite(int fd, const void *buf, size_t len, int timeoutms)
 {
+	RING_CALL(timeoutms, .opcode = IORING_OP_WRITE, .fd = fd,
+			.addr = (uintptr_t)buf, .len = ring_len(len), .off = -1);
 	SEND_LOOP(fd, timeoutms, write, buf, len);
 }
 
 ssize_t
 xwritev(int fd, const struct iovec *iov, int iovcnt, int timeoutms)
 {
+	RING_CALL(timeoutms, .opcode = IORING_OP_WRITEV, .fd = fd,
+			.addr = (uintptr_t)iov, .len = iovcnt, .off = -1);
 	SEND_LOOP(fd, timeoutms, writev, iov, iovcnt);
 }
 
 ssize_t
 xsend(int fd, const void *buf, size_t len, int flags, int timeoutms)
 {
+	RING_CALL(timeoutms, .opcode = IORING_OP_SEND, .fd = fd,
+			.addr = (uintptr_t)buf, .len = ring_len(len), .msg_flags = flags);
 	SEND_LOOP(fd, timeoutms, send, buf, len, flags);
 }
 
@@ -942,6 +2634,22 @@ ssize_t
 xsendto(int s, const void *buf, size_t len, int flags,
 	 const struct sockaddr *dest_addr, socklen_t dest_len, int timeoutms)
 {
+#if HAS_IO_URING
+	struct iovec iov = { (void *)buf, len };
+	struct msghdr msg = {
+		.msg_name = (void *)dest_addr,
+		.msg_namelen = dest_len,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	ssize_t rc = xhub_ring(&(struct io_uring_sqe){
+			.opcode = IORING_OP_SENDMSG, .fd = s,
+			.addr = (uintptr_t)&msg, .len = 1, .msg_flags = flags
+		}, timeoutms);
+	if (rc != xerr_sys(EAGAIN)) {
+		return rc == xerr_io(CLOSE) ? 0 : rc;
+	}
+#endif
 	SEND_LOOP(s, timeoutms, sendto, buf, len, flags, dest_addr, dest_len);
 }
 
@@ -959,29 +2667,25 @@ xio(int fd, void *buf, size_t len, int timeoutms,
 		return xerr_sys(EINVAL);
 	}
 
-	struct timespec now;
-	int64_t abs;
-	if (timeoutms > 0) {
-		xclock_mono(&now);
-		abs = X_MSEC_TO_NSEC(timeoutms) + XCLOCK_NSEC(&now);
-	}
+	// the scope cuts each wait short so the timeout covers the whole call
+	struct xscope scope;
+	bool scoped = timeoutms >= 0 && xscope_enter(&scope, timeoutms) == 0;
 
 	size_t total = 0;
 	ssize_t rc;
 
 again:
 	rc = fn(fd, (uint8_t *)buf+total, len-total, timeoutms);
-	if (rc < 0) { return rc; }
+	if (rc < 0) { goto done; }
 	total += (size_t)rc;
 	if (total < len) {
-		if (timeoutms > 0) {
-			xclock_mono(&now);
-			timeoutms = X_NSEC_TO_MSEC(abs - XCLOCK_NSEC(&now));
-			if (timeoutms < 0) { timeoutms = 0; }
-		}
 		goto again;
 	}
-	return (ssize_t)total;
+	rc = (ssize_t)total;
+
+done:
+	if (scoped) { xscope_exit(&scope); }
+	return rc;
 }
 
 int
@@ -0,0 +1,294 @@
+#include "../include/crux/hub.h"
+#include "../include/crux/list.h"
+
+#include "task.h"
+#include "heap.h"
+#include "wheel.h"
+#include "poll.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+struct xhub_entry;
+
+/**
+ * @brief  Link for a task waiting on a descriptor, signal, or channel
+ *
+ * A task normally waits through the node embedded in its entry, while
+ * `xselect` uses one node per operation from the calling task's stack.
+ */
+struct xhub_wait {
+	struct xlist link;
+	struct xhub_entry *ent;
+	void *data;                    /** value exchanged with the waker */
+	int idx;                       /** operation index for `xselect` */
+};
+
+/**
+ * @brief  Run time recorded for one spawn site with `xhub_account`
+ */
+struct xhub_site_node {
+	struct xhub_site_node *next;
+	struct xhub_site site;
+};
+
+struct xhub_entry {
+	uint64_t magic;
+#define XHUB_MAGIC UINT64_C(0x989b369eac2205a3)
+	struct xheap_entry hent;       // overflow timeout handle
+	struct xwheel_entry went;      // timeout handle
+	struct xlist lent; // list handle for closed, immediate, wake, and ring lists
+	struct xlist pent; // list handle for polled list
+	struct xtask *t;
+	union xvalue vinit;
+	struct xhub *hub;
+	void (*fn)(struct xhub *, union xvalue val);
+	int poll_id, poll_type;
+	bool detached;
+	struct xhub_wait wait;         /** node for a single wait */
+	struct xhub_wait *waits;       /** nodes linked into io, signal, and park lists */
+	int nwaits;
+	int wait_idx;                  /** index of the node that resumed the task */
+	struct xlist *park;            /** wait list for XPOLL_PARK */
+	int park_rc;                   /** result passed by `xhub_unpark` */
+	bool cancelled;                /** waits fail with -ECANCELED */
+	bool interrupted;              /** a wait was ended by `xtask_cancel` */
+	int64_t deadline;              /** monotonic time waits end by, or 0 */
+	uint8_t prio;                  /** class of the immediate list it runs from */
+	unsigned io_calls;             /** I/O calls completed since it was resumed */
+	int64_t io_start;              /** time of the first of them */
+	struct xgroup *group;          /** group the task was spawned into */
+	struct xlist glink;            /** link in the group's children */
+	int (*group_fn)(struct xhub *, union xvalue);
+	int group_rc;                  /** result of `group_fn` */
+	int64_t ready_ns;              /** time the task became runnable, or 0 */
+	int64_t run_ns;                /** time the task was last resumed */
+	uint64_t cpu_ns;               /** time spent running before that */
+	struct xhub_site_node *site;   /** spawn site when accounting */
+#if HAS_IO_URING
+	bool ring_closed;              /** descriptor was closed during the operation */
+	struct __kernel_timespec ring_ts;
+#endif
+};
+
+#define XHUB_IO_PAGE 256           /** fd entries allocated together */
+#define XHUB_EVENTS 256            /** events taken from the poll per batch */
+
+struct xhub_io {
+	struct xlist in, out;
+#if HAS_IO_URING
+	struct xlist ring;             /** tasks with an operation in the ring */
+#endif
+	int type;
+	bool readable;                 /** false once a short read drained it */
+	int8_t stream;                 /** short reads drain it, or -1 if unknown */
+	bool busy_poll;                /** SO_BUSY_POLL has been tried */
+};
+
+/**
+ * @brief  Deferred spawn request for a hub owned by another thread
+ */
+struct xhub_spawn {
+	struct xlist link;
+	void (*fn)(struct xhub *, union xvalue);
+	union xvalue val;
+	const char *file;
+	int line;
+	bool pinned;                   /** may not be stolen by a sibling */
+	int64_t deadline;              /** deadline inherited from the spawner */
+	int prio;                      /** priority class */
+	struct xgroup *group;          /** group to join, or NULL */
+	int (*group_fn)(struct xhub *, union xvalue);
+};
+
+/**
+ * @brief  Node in the lock-free queue of posts from other threads
+ *
+ * A node with no `req.fn` is the completion of an offloaded call.
+ */
+struct xhub_post {
+	_Atomic(struct xhub_post *) next;
+	struct xhub_spawn req;
+};
+
+struct xhub {
+	struct xmgr mgr;
+	struct xpoll poll;
+	unsigned npolled;
+	unsigned ndetached;
+	int maxfd;                     /** upper bound from RLIMIT_NOFILE */
+	unsigned npages;               /** length of the fd page directory */
+	struct xhub_io **io;           /** fd pages, allocated when first used */
+	atomic_bool running;
+	atomic_bool woken;             /** set by `xhub_wake` for XPOLL_WAKE tasks */
+	unsigned batch;                /** dispatch budget per loop iteration */
+	unsigned epos, elen;           /** events of the batch being dispatched */
+	struct xevent events[XHUB_EVENTS];
+	struct xhub_stats stats;
+	bool account;                  /** time waits and runs of tasks */
+	struct xhub_site_node *sites;  /** run time by spawn site */
+	struct xwheel wheel;           /** millisecond timeouts */
+	struct xheap timeout;          /** timeouts beyond the wheel horizon */
+	struct xlist closed;
+	struct xlist immediate[XHUB_PRIOS]; /** runnable tasks by class */
+	unsigned prio_weight[XHUB_PRIOS];   /** turns before a lower class runs */
+	int prio_last;                 /** class of the last task taken */
+	unsigned prio_streak;          /** turns in a row taken by that class */
+	unsigned io_budget;            /** I/O calls a task may make without yielding */
+	int64_t io_budget_ns;          /** time a task may do I/O without yielding */
+	int64_t spin_max_ns;           /** longest busy-poll before blocking, or 0 */
+	int64_t spin_ns;               /** current busy-poll window */
+	bool spin_sockopt;             /** set SO_BUSY_POLL on polled sockets */
+	bool ring;                     /** complete I/O through the poll's ring */
+	struct xlist polled;
+	struct xlist wake;
+	struct xlist sig[31];
+	struct xhub_pool *pool;        /** owning pool or NULL */
+	int pool_idx;                  /** index within the owning pool */
+	atomic_bool pool_done;         /** run loop has exited within the pool */
+	atomic_uint nload;             /** live tasks plus queued spawns */
+	atomic_uint nqueued;           /** length of the inbox */
+	pthread_mutex_t lock;          /** guards the inbox */
+	struct xlist inbox;            /** spawn requests from other threads */
+	_Atomic(struct xhub_post *) post_head; /** last post pushed by producers */
+	struct xhub_post *post_tail;   /** next post for the hub to take */
+	struct xhub_post post_stub;
+	atomic_bool post_wake;         /** a wake for posts is already pending */
+	atomic_uint noffload;          /** offloaded calls not yet posted back */
+};
+
+struct xhub_pool {
+	atomic_bool running;
+	atomic_uint nbusy;             /** non-detached tasks plus queued spawns */
+	int nhubs;
+	struct xhub *hubs[0];
+};
+
+XLOCAL struct xhub *
+xhub_current(void);
+
+/**
+ * @brief  Copies the deadline and priority class of the current task
+ *
+ * Outside of a task the request gets no deadline and the normal class.
+ *
+ * @param  req  spawn request to update
+ */
+XLOCAL void
+xhub_inherit(struct xhub_spawn *req);
+
+XLOCAL int
+xhub_spawn_local(struct xhub *hub, const struct xhub_spawn *req, bool counted);
+
+XLOCAL void
+xhub_poke(struct xhub *hub);
+
+/**
+ * @brief  Queues a post for the hub from any thread
+ *
+ * @param  hub   hub pointer
+ * @param  post  node to hand over
+ */
+XLOCAL void
+xhub_post_push(struct xhub *hub, struct xhub_post *post);
+
+/**
+ * @brief  Resumes the task waiting on an offloaded call
+ *
+ * This is called by the hub when it takes a completion node from its post
+ * queue. The call is released here if its task has moved on or is gone,
+ * otherwise the task releases it when it resumes.
+ *
+ * @param  post  completion node
+ * @param  gone  the hub is being freed along with its tasks
+ */
+XLOCAL void
+xhub_offload_done(struct xhub_post *post, bool gone);
+
+/**
+ * @brief  Offloads a call that owns its argument
+ *
+ * This is `xhub_offload` for an `arg` that cannot outlive the calling
+ * task's frame, such as state allocated for the call. If the task stops
+ * waiting first, `*owned` is set to false and `release` is called with `arg`
+ * once `fn` has finished. Otherwise `arg` stays with the caller.
+ *
+ * @param  fn         function to run on a worker
+ * @param  arg        argument for `fn` and `release`
+ * @param  release    frees `arg` after an abandoned call
+ * @param  timeoutms  timeout in milliseconds or `XTIMEOUT_NONE`
+ * @param[out]  owned  whether the caller still owns `arg`
+ * @return  result of `fn`, or -errno on error
+ */
+XLOCAL int
+xhub_offload_owned(int (*fn)(void *), void *arg, void (*release)(void *),
+		int timeoutms, bool *owned);
+
+/**
+ * @brief  Parks the current task on a wait list until it is unparked
+ *
+ * The task is linked into `list` through a `struct xhub_wait` node and counts
+ * as a polled task, so the hub keeps running while it waits. Another task on
+ * the same hub resumes it with `xhub_unpark`.
+ *
+ * @param  list       wait list owned by the caller
+ * @param  data       value stored in the node's `data` for the waker
+ * @param  timeoutms  timeout in milliseconds or `XTIMEOUT_NONE`
+ * @return  value passed to `xhub_unpark`, `-ETIMEDOUT`, or `-EPERM` outside
+ *          of a task
+ */
+XLOCAL int
+xhub_park(struct xlist *list, void *data, int timeoutms);
+
+/**
+ * @brief  Removes a parked task from every wait list and schedules it to run
+ *
+ * @param  w   node of the parked task that was selected
+ * @param  rc  value returned from `xhub_park`
+ */
+XLOCAL void
+xhub_unpark(struct xhub_wait *w, int rc);
+
+#if HAS_IO_URING
+
+/**
+ * @brief  Submits an operation through the ring and parks the current task
+ *
+ * The task is resumed directly from the completion. When there is no current
+ * task, no ring, or the timeout is `XTIMEOUT_DETACH`, `-EAGAIN` is returned
+ * and the caller should fall back to waiting for readiness.
+ *
+ * @param  sqe        operation template without `user_data`
+ * @param  timeoutms  milliseconds until timeout, or -1 for infinite
+ * @return  completion result, `xerr_io(CLOSE)` if the descriptor was closed
+ */
+XLOCAL ssize_t
+xhub_ring(const struct io_uring_sqe *sqe, int timeoutms);
+
+#endif
+
+/**
+ * @brief  Spawns a request on a hub of the pool
+ *
+ * @param  pool  pool pointer
+ * @param  idx   hub index, or -1 for the least loaded hub
+ * @param  req   spawn request, copied if queued
+ * @return  0 on success, -errno on error
+ */
+XLOCAL int
+xhub_pool_submit(struct xhub_pool *pool, int idx, const struct xhub_spawn *req);
+
+XLOCAL void
+xhub_pool_busy(struct xhub_pool *pool, int delta);
+
+XLOCAL bool
+xhub_pool_active(const struct xhub_pool *pool);
+
+XLOCAL int
+xhub_pool_drain(struct xhub *hub);
+
+XLOCAL int
+xhub_pool_steal(struct xhub *hub);
+
+XLOCAL void
+xhub_pool_clear(struct xhub *hub);
@@ -1,10 +1,12 @@
 #include "../include/crux/net.h"
 #include "../include/crux/err.h"
 #include "../include/crux/poll.h"
+#include "hub.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <assert.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <netinet/tcp.h>
@@ -107,27 +109,61 @@ error:
 	return ec;
 }
 
+struct resolve {
+	const char *host, *serv;
+	struct addrinfo hints, *res;
+};
+
 static int
-open_inet(const char *host, const char *serv, int type, int flags, union xaddr *addr, int timeoutms)
+resolve(void *data)
 {
-	struct addrinfo hints, *res;
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = type;
-	hints.ai_flags = (flags & XPASSIVE) ? AI_PASSIVE : 0;
+	struct resolve *r = data;
+	int ec = getaddrinfo(r->host, r->serv, &r->hints, &r->res);
+	return ec == 0 ? 0 : xerr_addr(ec);
+}
+
+static void
+free_resolve(void *data)
+{
+	struct resolve *r = data;
+	if (r->res) { freeaddrinfo(r->res); }
+	free(r);
+}
 
-	int ec = getaddrinfo(host, serv, &hints, &res);
-	if (ec < 0) {
-		return xerr_addr(ec);
+static int
+open_inet(const char *host, const char *serv, int type, int flags, union xaddr *addr, int timeoutms)
+{
+	// the lookup outlives this frame if the task stops waiting for it
+	struct resolve *r = calloc(1, sizeof(*r) + strlen(host) + 1 + strlen(serv) + 1);
+	if (r == NULL) {
+		return xerrno;
+	}
+	char *copy = (char *)(r + 1);
+	r->host = strcpy(copy, host);
+	r->serv = strcpy(copy + strlen(host) + 1, serv);
+	r->hints.ai_family = AF_UNSPEC;
+	r->hints.ai_socktype = type;
+	r->hints.ai_flags = (flags & XPASSIVE) ? AI_PASSIVE : 0;
+
+	// resolving may block on the network so it runs off the hub thread
+	bool owned;
+	int ec = xhub_offload_owned(resolve, r, free_resolve, XTIMEOUT_NONE, &owned);
+	if (!owned) {
+		return ec;
+	}
+	if (ec == xerr_sys(EAGAIN)) {
+		ec = resolve(r);
 	}
 
-	for (struct addrinfo *r = res; res; res = res->ai_next) {
-		if ((ec = open_addr(r->ai_addr, r->ai_addrlen, r->ai_family, type, flags, timeoutms)) >= 0) {
-			memcpy(&addr->ss, r->ai_addr, r->ai_addrlen);
-			break;
+	if (ec == 0) {
+		for (struct addrinfo *ai = r->res; ai; ai = ai->ai_next) {
+			if ((ec = open_addr(ai->ai_addr, ai->ai_addrlen, ai->ai_family, type, flags, timeoutms)) >= 0) {
+				memcpy(&addr->ss, ai->ai_addr, ai->ai_addrlen);
+				break;
+			}
 		}
 	}
-	freeaddrinfo(res);
+	free_resolve(r);
 
 	return ec;
 }
@@ -233,7 +269,8 @@ open_sock(const char *net, int type, int flags, int timeoutms, union xaddr *addr
 		strcpy(host, "0.0.0.0");
 	}
 	else {
-		strncpy(host, start, end - start);
+		memcpy(host, start, end - start);
+		host[end - start] = '\0';
 	}
 
 	/* If the service is empty, default to INPORT_ANY. */
@@ -284,8 +321,8 @@ error:
 	return rc;
 }
 
-int
-xaccept(int s, int flags, int timeoutms, union xaddr *addr)
+static int
+accept_wait(int s, int flags, int polltype, int timeoutms, union xaddr *addr)
 {
 	for (;;) {
 		socklen_t len = sizeof(addr->ss);
@@ -308,7 +345,7 @@ xaccept(int s, int flags, int timeoutms, union xaddr *addr)
 
 		int rc = xerrno;
 		if (rc == xerr_sys(EAGAIN)) {
-			rc = xwait(s, XPOLL_IN, timeoutms);
+			rc = xwait(s, polltype, timeoutms);
 			if (rc == 0) { continue; }
 			if (rc == xerr_io(CLOSE)) { rc = xerr_sys(ECONNABORTED); }
 		}
@@ -316,15 +353,48 @@ xaccept(int s, int flags, int timeoutms, union xaddr *addr)
 	}
 }
 
+int
+xaccept(int s, int flags, int timeoutms, union xaddr *addr)
+{
+#if HAS_IO_URING
+	socklen_t alen = sizeof(addr->ss);
+	int rc = xhub_ring(&(struct io_uring_sqe){
+			.opcode = IORING_OP_ACCEPT, .fd = s,
+			.addr = (uintptr_t)&addr->sa, .addr2 = (uintptr_t)&alen,
+			.accept_flags = SOCK_NONBLOCK|SOCK_CLOEXEC
+		}, timeoutms);
+	if (rc >= 0) { return set_flags(rc, SOCK_STREAM, flags); }
+	if (rc == xerr_io(CLOSE)) { return xerr_sys(ECONNABORTED); }
+	if (rc != xerr_sys(EAGAIN)) { return rc; }
+#endif
+
+	return accept_wait(s, flags, XPOLL_IN, timeoutms, addr);
+}
+
 int
 xconnect(int s, const struct sockaddr *addr, socklen_t addrlen, int timeoutms)
 {
-	for (;;) {
+#if HAS_IO_URING
+	int rc = xhub_ring(&(struct io_uring_sqe){
+			.opcode = IORING_OP_CONNECT, .fd = s,
+			.addr = (uintptr_t)addr, .off = addrlen
+		}, timeoutms);
+	if (rc == 0) { return s; }
+	if (rc == xerr_io(CLOSE)) { return xerr_sys(ECONNABORTED); }
+	if (rc != xerr_sys(EAGAIN)) { return rc; }
+#endif
+
+	for (bool waited = false;; waited = true) {
 		if (connect(s, addr, addrlen) == 0) {
 			return s;
 		}
 		int rc = xerrno;
-		if (rc == xerr_sys(EAGAIN)) {
+		// a non-blocking connect that completed while waiting reports EISCONN
+		if (rc == xerr_sys(EISCONN) && waited) {
+			return s;
+		}
+		if (rc == xerr_sys(EAGAIN) || rc == xerr_sys(EINPROGRESS) ||
+				rc == xerr_sys(EALREADY)) {
 			rc = xwait(s, XPOLL_OUT, timeoutms);
 			if (rc == 0) { continue; }
 			if (rc == xerr_io(CLOSE)) { rc = xerr_sys(ECONNABORTED); }
@@ -392,3 +462,152 @@ xpeeraddr(int fd, union xaddr *addr)
 	return rc == 0 ? 0 : xerrno;
 }
 
+struct xlistener {
+	int nshards;
+	bool shared;                   /** every shard accepts on the first socket */
+	struct {
+		int fd;
+		_Atomic uint64_t accepted;
+	} shards[];
+};
+
+int
+xlisten_sharded(struct xlistener **lp, const char *net, int flags, int nshards,
+		union xaddr *addr)
+{
+	assert(lp != NULL);
+	assert(net != NULL);
+	assert(addr != NULL);
+
+	if (nshards < 1) {
+		return xerr_sys(EINVAL);
+	}
+
+	struct xlistener *l = calloc(1, sizeof(*l) + nshards * sizeof(l->shards[0]));
+	if (l == NULL) {
+		return xerrno;
+	}
+
+	l->nshards = nshards;
+	for (int i = 0; i < nshards; i++) {
+		l->shards[i].fd = -1;
+	}
+
+	// the first bind settles the address, such as an ephemeral port, that
+	// the other shards bind to
+	int fd = xbind(net, SOCK_STREAM, flags | XREUSEPORT, addr);
+	bool reuse = fd >= 0;
+	if (fd == xerr_sys(ENOTSUP)) {
+		fd = xbind(net, SOCK_STREAM, flags, addr);
+	}
+	if (fd < 0) {
+		free(l);
+		return fd;
+	}
+	l->shards[0].fd = fd;
+
+	int rc = xsockaddr(fd, addr);
+	if (rc < 0) {
+		xlistener_free(&l);
+		return rc;
+	}
+
+	// a UNIX socket path can only be bound once, and an inherited socket
+	// can't be bound again at all
+	int inherited;
+	l->shared = !reuse || addr->sa.sa_family == AF_UNIX || parse_int(net, &inherited);
+
+	for (int i = 1; i < nshards; i++) {
+		if (l->shared) {
+			l->shards[i].fd = fd;
+			continue;
+		}
+		socklen_t len = addr->sa.sa_family == AF_INET6 ?
+			sizeof(addr->in6) : sizeof(addr->in);
+		rc = open_addr(&addr->sa, len, addr->sa.sa_family, SOCK_STREAM,
+				flags | XREUSEPORT | XPASSIVE, -1);
+		if (rc < 0) {
+			xlistener_free(&l);
+			return rc;
+		}
+		l->shards[i].fd = rc;
+	}
+
+	*lp = l;
+	return 0;
+}
+
+void
+xlistener_free(struct xlistener **lp)
+{
+	assert(lp != NULL);
+
+	struct xlistener *l = *lp;
+	if (l != NULL) {
+		*lp = NULL;
+		int n = l->shared ? 1 : l->nshards;
+		for (int i = 0; i < n; i++) {
+			xclose(l->shards[i].fd);
+		}
+		free(l);
+	}
+}
+
+int
+xlistener_shards(const struct xlistener *l)
+{
+	assert(l != NULL);
+
+	return l->nshards;
+}
+
+bool
+xlistener_is_shared(const struct xlistener *l)
+{
+	assert(l != NULL);
+
+	return l->shared;
+}
+
+int
+xlistener_fd(const struct xlistener *l, int shard)
+{
+	assert(l != NULL);
+
+	if (shard < 0 || shard >= l->nshards) {
+		return xerr_sys(EINVAL);
+	}
+	return l->shards[shard].fd;
+}
+
+int
+xlistener_accept(struct xlistener *l, int shard, int flags, int timeoutms,
+		union xaddr *addr)
+{
+	assert(l != NULL);
+
+	if (shard < 0 || shard >= l->nshards) {
+		return xerr_sys(EINVAL);
+	}
+
+	// the ring's accept doesn't poll exclusively, so a shared socket always
+	// waits for readiness on the hub's own poll
+	int fd = l->shared ?
+		accept_wait(l->shards[shard].fd, flags, XPOLL_IN|XPOLL_EXCL, timeoutms, addr) :
+		xaccept(l->shards[shard].fd, flags, timeoutms, addr);
+	if (fd >= 0) {
+		atomic_fetch_add_explicit(&l->shards[shard].accepted, 1, memory_order_relaxed);
+	}
+	return fd;
+}
+
+uint64_t
+xlistener_accepted(const struct xlistener *l, int shard)
+{
+	assert(l != NULL);
+
+	if (shard < 0 || shard >= l->nshards) {
+		return 0;
+	}
+	return atomic_load_explicit(&l->shards[shard].accepted, memory_order_relaxed);
+}
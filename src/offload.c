@@ -0,0 +1,311 @@
+#include "hub.h"
+#include "../include/crux/err.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <assert.h>
+
+#define DEFAULT_QUEUE 1024
+
+/**
+ * @brief  Blocking call waiting for or running on a worker thread
+ */
+struct xoffload {
+	struct xhub_post post;         /** completion handed back to the hub */
+	struct xlist link;             /** position in the pending queue */
+	int (*fn)(void *);
+	void *arg;
+	int rc;
+	struct xhub *hub;
+	struct xlist wait;             /** calling task until it gives up */
+	void (*release)(void *);       /** frees `arg` once given up on */
+	bool done;                     /** completion reached the hub */
+	bool abandoned;                /** the calling task has moved on */
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool init;
+	struct xlist queue;
+	unsigned max_workers;
+	unsigned max_queue;
+	unsigned workers;
+	unsigned idle;
+	unsigned busy;
+	unsigned queued;
+	unsigned queued_max;
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t rejected;
+	int64_t busy_ns;
+	int64_t started_ns;            /** sum of worker start times */
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static int64_t
+now_ns(void)
+{
+	struct timespec c;
+	xclock_mono(&c);
+	return XCLOCK_NSEC(&c);
+}
+
+/**
+ * @brief  Sets up the pool with default limits
+ *
+ * The pool lock must be held.
+ */
+static void
+init_locked(void)
+{
+	if (pool.init) { return; }
+
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	xlist_init(&pool.queue);
+	pool.max_workers = n > 2 ? (unsigned)n : 2;
+	pool.max_queue = DEFAULT_QUEUE;
+	pool.init = true;
+}
+
+static void *
+worker(void *data)
+{
+	(void)data;
+
+	// signals are left for hubs that wait on them with `xsignal`
+	sigset_t mask;
+	sigfillset(&mask);
+	sigdelset(&mask, SIGSEGV);
+	sigdelset(&mask, SIGBUS);
+	sigdelset(&mask, SIGFPE);
+	sigdelset(&mask, SIGILL);
+	sigdelset(&mask, SIGTRAP);
+	sigdelset(&mask, SIGABRT);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		struct xlist *elem;
+		while ((elem = xlist_first(&pool.queue, X_ASCENDING)) == NULL) {
+			pool.idle++;
+			pthread_cond_wait(&pool.cond, &pool.lock);
+			pool.idle--;
+		}
+
+		struct xoffload *job = xcontainer(elem, struct xoffload, link);
+		xlist_del(elem);
+		pool.queued--;
+		pool.busy++;
+		pthread_mutex_unlock(&pool.lock);
+
+		int64_t start = now_ns();
+		job->rc = job->fn(job->arg);
+		int64_t end = now_ns();
+
+		// the hub owns the job again once it is posted, but may only be freed
+		// once the worker is done waking it
+		struct xhub *hub = job->hub;
+		xhub_post_push(hub, &job->post);
+		atomic_fetch_sub(&hub->noffload, 1);
+
+		pthread_mutex_lock(&pool.lock);
+		pool.busy--;
+		pool.completed++;
+		pool.busy_ns += end - start;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief  Starts another worker thread
+ *
+ * The pool lock must be held.
+ *
+ * @return  0 on success, -errno on error
+ */
+static int
+start_worker_locked(void)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	int err = pthread_create(&thread, &attr, worker, NULL);
+	pthread_attr_destroy(&attr);
+	if (err != 0) {
+		return xerr_sys(err);
+	}
+
+	pool.workers++;
+	pool.started_ns += now_ns();
+	return 0;
+}
+
+/**
+ * @brief  Adds a job to the pending queue and makes sure a worker sees it
+ *
+ * @param  job  job to run
+ * @return  0 on success, -errno on error
+ */
+static int
+submit(struct xoffload *job)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&pool.lock);
+	init_locked();
+
+	if (pool.queued >= pool.max_queue) {
+		pool.rejected++;
+		rc = xerr_sys(EAGAIN);
+		goto done;
+	}
+
+	if (pool.idle == 0 && pool.workers < pool.max_workers) {
+		rc = start_worker_locked();
+		// existing workers will still get to it
+		if (rc < 0 && pool.workers > 0) { rc = 0; }
+		if (rc < 0) { goto done; }
+	}
+
+	xlist_add(&pool.queue, &job->link, X_ASCENDING);
+	pool.submitted++;
+	pool.queued++;
+	if (pool.queued > pool.queued_max) { pool.queued_max = pool.queued; }
+	pthread_cond_signal(&pool.cond);
+
+done:
+	pthread_mutex_unlock(&pool.lock);
+	return rc;
+}
+
+static int
+offload(int (*fn)(void *), void *arg, void (*release)(void *), int timeoutms,
+		bool *owned)
+{
+	assert(fn != NULL);
+
+	*owned = true;
+
+	// without a hub there is nothing else to keep running
+	struct xhub *hub = xhub_current();
+	if (hub == NULL) {
+		return fn(arg);
+	}
+
+	struct xoffload *job = malloc(sizeof(*job));
+	if (job == NULL) {
+		return xerrno;
+	}
+
+	job->post.req = (struct xhub_spawn) { .fn = NULL };
+	job->fn = fn;
+	job->arg = arg;
+	job->rc = 0;
+	job->hub = hub;
+	xlist_init(&job->wait);
+	job->release = release;
+	job->done = false;
+	job->abandoned = false;
+
+	atomic_fetch_add(&hub->noffload, 1);
+	int rc = submit(job);
+	if (rc < 0) {
+		atomic_fetch_sub(&hub->noffload, 1);
+		free(job);
+		return rc;
+	}
+
+	// the completion can't be taken before this parks since both run on
+	// the hub's thread
+	rc = xhub_park(&job->wait, NULL, timeoutms);
+
+	// the call may have finished after a timeout but before this resumed
+	if (job->done) {
+		rc = job->rc;
+		free(job);
+		return rc;
+	}
+
+	job->abandoned = true;
+	*owned = false;
+	return rc;
+}
+
+int
+xhub_offload(int (*fn)(void *), void *arg, int timeoutms)
+{
+	bool owned;
+	return offload(fn, arg, NULL, timeoutms, &owned);
+}
+
+int
+xhub_offload_owned(int (*fn)(void *), void *arg, void (*release)(void *),
+		int timeoutms, bool *owned)
+{
+	assert(release != NULL);
+	assert(owned != NULL);
+
+	return offload(fn, arg, release, timeoutms, owned);
+}
+
+void
+xhub_offload_done(struct xhub_post *post, bool gone)
+{
+	struct xoffload *job = xcontainer(post, struct xoffload, post);
+
+	job->done = true;
+
+	// a waiting task takes the result and frees the job when it resumes
+	if (!job->abandoned && !gone) {
+		struct xlist *elem = xlist_first(&job->wait, X_ASCENDING);
+		if (elem) {
+			xhub_unpark(xcontainer(elem, struct xhub_wait, link), job->rc);
+		}
+		return;
+	}
+
+	if (job->release) {
+		job->release(job->arg);
+	}
+	free(job);
+}
+
+int
+xhub_offload_config(unsigned workers, unsigned queue)
+{
+	if (workers == 0 || queue == 0) {
+		return xerr_sys(EINVAL);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	init_locked();
+	pool.max_workers = workers;
+	pool.max_queue = queue;
+	pthread_mutex_unlock(&pool.lock);
+	return 0;
+}
+
+void
+xhub_offload_stats(struct xhub_offload_stats *stats)
+{
+	assert(stats != NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	stats->workers = pool.workers;
+	stats->busy = pool.busy;
+	stats->queued = pool.queued;
+	stats->queued_max = pool.queued_max;
+	stats->submitted = pool.submitted;
+	stats->completed = pool.completed;
+	stats->rejected = pool.rejected;
+	stats->busy_ns = (uint64_t)pool.busy_ns;
+	stats->alive_ns = (uint64_t)(pool.workers * now_ns() - pool.started_ns);
+	pthread_mutex_unlock(&pool.lock);
+}
@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <assert.h>
+#include <signal.h>
+#include <pthread.h>
 
 #if HAS_KQUEUE
 
@@ -66,7 +68,7 @@ kq_ctl_io(struct xpoll *poll, int id, int oldtype, int newtype)
 	uint16_t wpos = poll->wpos;
 
 	// if the change list is full, register these events now
-	if (n >= xlen(poll->events) - wpos) {
+	if (n >= (size_t)(poll->size - wpos)) {
 		if (kevent(poll->fd, ev, n, NULL, 0, &zero) < 0) {
 			return xerrno;
 		}
@@ -153,7 +155,7 @@ static int
 kq_wait(struct xpoll *poll, struct timespec *ts)
 {
 	struct kevent *events = poll->events, *changes = events + poll->rlen;
-	int nevents = xlen(poll->events), nchanges = poll->wpos - poll->rlen;
+	int nevents = poll->size, nchanges = poll->wpos - poll->rlen;
 
 	int rc = kevent(poll->fd, changes, nchanges, events, nevents, ts);
 	if (rc < 0) { return xerrno; }
@@ -177,6 +179,130 @@ kq_wait(struct xpoll *poll, struct timespec *ts)
 #include <sys/signalfd.h>
 #include <sys/eventfd.h>
 
+#if HAS_EPOLL_PWAIT2
+# include <sys/syscall.h>
+# include <linux/time_types.h>
+#endif
+
+#if HAS_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define RING_ENTRIES 256
+
+static int
+ring_enter(struct xring *ring, unsigned submit, unsigned min, unsigned flags)
+{
+	int rc;
+	do {
+		rc = syscall(__NR_io_uring_enter, ring->fd, submit, min, flags, NULL, 0);
+	} while (rc < 0 && errno == EINTR);
+	return rc < 0 ? xerrno : rc;
+}
+
+static void *
+ring_map(int fd, size_t size, off_t off)
+{
+	void *p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, off);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+static void
+ring_final(struct xring *ring)
+{
+	if (ring->sqes) { munmap(ring->sqes, ring->sqes_size); }
+	if (ring->cq_map) { munmap(ring->cq_map, ring->cq_size); }
+	if (ring->sq_map) { munmap(ring->sq_map, ring->sq_size); }
+	xretry(close(ring->evfd));
+	xretry(close(ring->fd));
+	ring->fd = -1;
+	ring->evfd = -1;
+}
+
+static void
+ring_init(struct xring *ring)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	memset(ring, 0, sizeof(*ring));
+	ring->evfd = -1;
+
+	// the ring is optional so any failure leaves the poll with readiness only
+	if ((ring->fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p)) < 0) {
+		ring->fd = -1;
+		return;
+	}
+
+	// sockets must be parked by the kernel rather than failing with EAGAIN,
+	// and completions must never be dropped
+	unsigned need = IORING_FEAT_NODROP|IORING_FEAT_FAST_POLL;
+	if ((p.features & need) != need) {
+		goto error;
+	}
+
+	ring->sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+
+	ring->sq_map = ring_map(ring->fd, ring->sq_size, IORING_OFF_SQ_RING);
+	ring->cq_map = ring_map(ring->fd, ring->cq_size, IORING_OFF_CQ_RING);
+	ring->sqes = ring_map(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+	if (!ring->sq_map || !ring->cq_map || !ring->sqes) {
+		goto error;
+	}
+
+	uint8_t *sq = ring->sq_map, *cq = ring->cq_map;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	if ((ring->evfd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0 ||
+			syscall(__NR_io_uring_register, ring->fd,
+				IORING_REGISTER_EVENTFD, &ring->evfd, 1) < 0) {
+		goto error;
+	}
+
+	return;
+
+error:
+	ring_final(ring);
+}
+
+static int
+ring_submit(struct xring *ring)
+{
+	if (ring->pending == 0) {
+		return 0;
+	}
+
+	int rc = ring_enter(ring, ring->pending, 0, 0);
+	if (rc >= 0) {
+		ring->pending -= (unsigned)rc;
+		return 0;
+	}
+	// the kernel applies back-pressure while completions are outstanding
+	if (rc == xerr_sys(EAGAIN) || rc == xerr_sys(EBUSY)) {
+		return 0;
+	}
+	return rc;
+}
+
+static bool
+ring_ready(struct xring *ring)
+{
+	return *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) ||
+		(__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW);
+}
+
+#endif
+
 static int
 ep_init(struct xpoll *poll)
 {
@@ -185,6 +311,9 @@ ep_init(struct xpoll *poll)
 	poll->fd = -1;
 	poll->sigfd = -1;
 	poll->evfd = -1;
+#if HAS_EPOLL_PWAIT2
+	poll->pwait2 = true;
+#endif
 
     if ((poll->fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
 		goto error;
@@ -212,10 +341,22 @@ ep_init(struct xpoll *poll)
 		goto error;
 	}
 
+#if HAS_IO_URING
+	ring_init(&poll->ring);
+	if (poll->ring.fd >= 0) {
+		ev.events = EPOLLIN|EPOLLET;
+		ev.data.fd = poll->ring.evfd;
+		if (epoll_ctl(poll->fd, EPOLL_CTL_ADD, poll->ring.evfd, &ev) < 0) {
+			ring_final(&poll->ring);
+		}
+	}
+#endif
+
 	return 0;
 
 error:
 	rc = xerrno;
+	xretry(close(poll->evfd));
 	xretry(close(poll->sigfd));
 	xretry(close(poll->fd));
 	return rc;
@@ -224,6 +365,12 @@ error:
 static void
 ep_final(struct xpoll *poll)
 {
+#if HAS_IO_URING
+	if (poll->ring.fd >= 0) {
+		ring_final(&poll->ring);
+	}
+#endif
+	xretry(close(poll->evfd));
 	xretry(close(poll->sigfd));
 	xretry(close(poll->fd));
 }
@@ -240,6 +387,10 @@ ep_ctl_io(struct xpoll *poll, int id, int oldtype, int newtype)
 		if (newtype & XPOLL_IN) { ev.events |= EPOLLIN; }
 		if (newtype & XPOLL_OUT) { ev.events |= EPOLLOUT; }
 		op = oldtype ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+#ifdef EPOLLEXCLUSIVE
+		// only allowed when adding, and the descriptor can't be modified after
+		if ((newtype & XPOLL_EXCL) && op == EPOLL_CTL_ADD) { ev.events |= EPOLLEXCLUSIVE; }
+#endif
 	}
 	else {
 		op = EPOLL_CTL_DEL;
@@ -308,6 +459,19 @@ ep_next(struct xpoll *poll, struct xevent *ev)
 		return 0;
 	}
 
+#if HAS_IO_URING
+	if (src->data.fd == poll->ring.evfd) {
+		uint64_t val;
+		ssize_t n = read(poll->ring.evfd, &val, sizeof(val));
+		if (n < 0 && errno != EAGAIN) { return xerrno; }
+		if (n == sizeof(val)) {
+			ev->type = XPOLL_RING;
+			return 1;
+		}
+		return 0;
+	}
+#endif
+
 	if (src->events == 0) {
 		return 0;
 	}
@@ -345,17 +509,38 @@ ep_next(struct xpoll *poll, struct xevent *ev)
 static int
 ep_wait(struct xpoll *poll, struct timespec *ts)
 {
+	int rc;
+
+#if HAS_EPOLL_PWAIT2
+	if (poll->pwait2) {
+		struct __kernel_timespec kts, *ktsp = NULL;
+		if (ts) {
+			kts.tv_sec = ts->tv_sec;
+			kts.tv_nsec = ts->tv_nsec;
+			ktsp = &kts;
+		}
+		rc = syscall(__NR_epoll_pwait2, poll->fd, poll->events, poll->size, ktsp, NULL, 0);
+		if (rc >= 0) { goto done; }
+		if (errno != ENOSYS) { return xerrno; }
+		poll->pwait2 = false;
+	}
+#endif
+
+	// rounded up so a timer isn't polled for again just short of expiring
 	int ms = -1;
 	if (ts) {
-		int64_t t = X_NSEC_TO_MSEC(ts->tv_nsec) + X_SEC_TO_MSEC(ts->tv_sec);
+		int64_t t = (XCLOCK_NSEC(ts) + X_NSEC_PER_MSEC - 1) / X_NSEC_PER_MSEC;
 		if (t >= 0) {
 			ms = t > INT_MAX ? INT_MAX : (int)t;
 		}
 	}
 
-	int rc = epoll_wait(poll->fd, poll->events, xlen(poll->events), ms);
+	rc = epoll_wait(poll->fd, poll->events, poll->size, ms);
 	if (rc < 0) { return xerrno; }
 
+#if HAS_EPOLL_PWAIT2
+done:
+#endif
 	poll->rpos = 0;
 	poll->rlen = rc;
 	return rc;
@@ -381,8 +566,18 @@ xpoll_init(struct xpoll *poll)
 	sigemptyset(&poll->sigset);
 	poll->rpos = 0;
 	poll->rlen = 0;
+	poll->size = XPOLL_BATCH;
+	poll->events = malloc(sizeof(*poll->events) * poll->size);
+	if (poll->events == NULL) {
+		return xerrno;
+	}
 
-	return c_init(poll);
+	rc = c_init(poll);
+	if (rc < 0) {
+		free(poll->events);
+		poll->events = NULL;
+	}
+	return rc;
 }
 
 void
@@ -398,6 +593,8 @@ xpoll_final(struct xpoll *poll)
 {
 	if (poll != NULL) { 
 		c_final(poll);
+		free(poll->events);
+		poll->events = NULL;
 	}
 }
 
@@ -421,25 +618,34 @@ xpoll_ctl(struct xpoll *poll, int id, int oldtype, int newtype)
 	if (sig && !io) {
 		if (id < 1 || id > 31) { return xerr_sys(EINVAL); }
 
-		sigset_t prev = poll->sigset;
+		sigset_t prev = poll->sigset, one;
+		int how;
 
 		if (newtype & XPOLL_SIG) {
 			if (sigismember(&prev, id)) { return 0; }
 			sigaddset(&poll->sigset, id);
+			how = SIG_BLOCK;
 		}
 		else {
 			if (!sigismember(&prev, id)) { return 0; }
 			sigdelset(&poll->sigset, id);
+			how = SIG_UNBLOCK;
 		}
 
-		if (sigprocmask(SIG_SETMASK, &poll->sigset, NULL) < 0) {
+		// only change this signal so masks set up by the caller (such as a
+		// hub pool blocking signals in every thread) are left intact
+		sigemptyset(&one);
+		sigaddset(&one, id);
+
+		int rc = pthread_sigmask(how, &one, NULL);
+		if (rc != 0) {
 			poll->sigset = prev;
-			return xerrno;
+			return xerr_sys(rc);
 		}
 
-		int rc = c_ctl_sig(poll, id, oldtype, newtype);
+		rc = c_ctl_sig(poll, id, oldtype, newtype);
 		if (rc < 0) {
-			sigprocmask(SIG_SETMASK, &prev, NULL);
+			pthread_sigmask(how == SIG_BLOCK ? SIG_UNBLOCK : SIG_BLOCK, &one, NULL);
 			poll->sigset = prev;
 			return rc;
 		}
@@ -457,22 +663,22 @@ xpoll_wake(struct xpoll *poll)
 	return c_wake(poll);
 }
 
-int
-xpoll_wait(struct xpoll *poll, int64_t ms, struct xevent *ev)
+/**
+ * @brief  Reads the next event, waiting up to `ns` nanoseconds for one
+ */
+static int
+wait_next(struct xpoll *poll, int64_t ns, struct xevent *ev)
 {
-	assert(poll != NULL);
-
 	int rc;
 	struct timespec c;
-	struct timespec *tsp = ms < 0 ? NULL : &c;
-	struct xtimeout timeo;
+	struct timespec *tsp = ns < 0 ? NULL : &c;
 
 	ev->type = 0;
 	ev->id = -1;
 	ev->errcode = 0;
 
 	xclock_mono(&poll->clock);
-	xtimeout_start(&timeo, ms, &poll->clock);
+	int64_t end = ns < 0 ? 0 : XCLOCK_NSEC(&poll->clock) + ns;
 
 next:
 	while (poll->rpos < poll->rlen) {
@@ -481,8 +687,25 @@ next:
 	}
 
 wait:
+#if HAS_IO_URING
+	// queued operations are submitted just before blocking and any that
+	// completed inline are reported without waiting
+	if (poll->ring.fd >= 0) {
+		rc = ring_submit(&poll->ring);
+		if (rc < 0) { goto done; }
+		if (ring_ready(&poll->ring)) {
+			ev->type = XPOLL_RING;
+			rc = 1;
+			goto done;
+		}
+	}
+#endif
+
 	xclock_mono(&poll->clock);
-	XCLOCK_SET_MSEC(&c, xtimeout(&timeo, &poll->clock));
+	if (tsp) {
+		int64_t left = end - XCLOCK_NSEC(&poll->clock);
+		XCLOCK_SET_NSEC(&c, left > 0 ? left : 0);
+	}
 
 	rc = c_wait(poll, tsp);
 	if (rc > 0)             { goto next; }
@@ -493,6 +716,185 @@ done:
 	return rc;
 }
 
+static int64_t
+ms_to_ns(int64_t ms)
+{
+	if (ms < 0) { return -1; }
+	return ms < INT64_MAX / X_NSEC_PER_MSEC ? X_MSEC_TO_NSEC(ms) : INT64_MAX / 2;
+}
+
+int
+xpoll_wait(struct xpoll *poll, int64_t ms, struct xevent *ev)
+{
+	assert(poll != NULL);
+
+	return wait_next(poll, ms_to_ns(ms), ev);
+}
+
+int
+xpoll_waitv(struct xpoll *poll, int64_t ms, struct xevent *evs, int n)
+{
+	return xpoll_waitv_ns(poll, ms_to_ns(ms), evs, n);
+}
+
+int
+xpoll_waitv_ns(struct xpoll *poll, int64_t ns, struct xevent *evs, int n)
+{
+	assert(poll != NULL);
+	assert(evs != NULL);
+
+	if (n < 1) {
+		return xerr_sys(EINVAL);
+	}
+
+	int rc = wait_next(poll, ns, &evs[0]);
+	if (rc <= 0) { return rc; }
+
+	// the rest only come from the buffer so this never blocks again
+	int i = 1;
+	while (i < n && (rc = xpoll_next(poll, &evs[i])) == 1) {
+		i++;
+	}
+	return rc < 0 ? rc : i;
+}
+
+int
+xpoll_set_batch(struct xpoll *poll, unsigned n)
+{
+	assert(poll != NULL);
+
+	if (n == 0 || n > XPOLL_BATCH_MAX) {
+		return xerr_sys(EINVAL);
+	}
+
+#if HAS_KQUEUE
+	// pending changes are kept after the results
+	unsigned used = poll->wpos;
+#else
+	unsigned used = poll->rlen;
+#endif
+	if (n < used) {
+		return xerr_sys(EBUSY);
+	}
+
+	void *events = realloc(poll->events, sizeof(*poll->events) * n);
+	if (events == NULL) {
+		return xerrno;
+	}
+
+	poll->events = events;
+	poll->size = n;
+	return 0;
+}
+
+int
+xpoll_next(struct xpoll *poll, struct xevent *ev)
+{
+	assert(poll != NULL);
+
+	ev->type = 0;
+	ev->id = -1;
+	ev->errcode = 0;
+
+	while (poll->rpos < poll->rlen) {
+		int rc = c_next(poll, ev);
+		if (rc != 0) { return rc; }
+	}
+	return 0;
+}
+
+#if HAS_IO_URING
+
+bool
+xpoll_has_ring(const struct xpoll *poll)
+{
+	return poll->ring.fd >= 0;
+}
+
+struct io_uring_sqe *
+xpoll_sqe(struct xpoll *poll, unsigned n)
+{
+	struct xring *ring = &poll->ring;
+	assert(ring->fd >= 0);
+
+	unsigned size = *ring->sq_mask + 1;
+	unsigned tail = *ring->sq_tail;
+	if (size - (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) < n) {
+		if (ring_submit(ring) < 0 ||
+				size - (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) < n) {
+			return NULL;
+		}
+	}
+
+	// the kernel only reads the queue during `io_uring_enter`, so the tail
+	// may be published before the caller fills in the entry
+	unsigned idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->pending++;
+	return sqe;
+}
+
+int
+xpoll_cancel(struct xpoll *poll, uint64_t udata)
+{
+	struct io_uring_sqe *sqe = xpoll_sqe(poll, 1);
+	if (sqe == NULL) {
+		return xerr_sys(EBUSY);
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = udata;
+	return 0;
+}
+
+int
+xpoll_reap(struct xpoll *poll, bool wait,
+		void (*fn)(uint64_t udata, int32_t res, void *data), void *data)
+{
+	struct xring *ring = &poll->ring;
+	assert(ring->fd >= 0);
+
+	int rc = ring_submit(ring);
+	if (rc < 0) { return rc; }
+
+	if (wait && !ring_ready(ring)) {
+		rc = ring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+		if (rc < 0) { return rc; }
+	}
+
+	unsigned mask = *ring->cq_mask;
+	int n = 0;
+
+	for (;;) {
+		unsigned head = *ring->cq_head;
+		if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			// overflowed completions are only moved into the queue on entry
+			if (!(__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) {
+				break;
+			}
+			rc = ring_enter(ring, 0, 0, IORING_ENTER_GETEVENTS);
+			if (rc < 0) { return rc; }
+			continue;
+		}
+
+		// release the entry before the callback so it may queue more work
+		struct io_uring_cqe *cqe = &ring->cqes[head & mask];
+		uint64_t udata = cqe->user_data;
+		int32_t res = cqe->res;
+		__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+		fn(udata, res, data);
+		n++;
+	}
+
+	return n;
+}
+
+#endif
+
 const struct timespec *
 xpoll_clock(const struct xpoll *poll)
 {
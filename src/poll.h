@@ -8,7 +8,36 @@
 # error unsupported platform
 #endif
 
+#if HAS_IO_URING
+# include <linux/io_uring.h>
+#endif
+
 #define XPOLL_WAKE (1<<3)  /** Type for poll wake up */
+#define XPOLL_RING (1<<4)  /** Type for io_uring completions */
+#define XPOLL_PARK (1<<5)  /** Type for tasks parked on a hub wait list */
+#define XPOLL_SELECT (1<<6) /** Type for tasks waiting in `xselect` */
+
+#if HAS_IO_URING
+
+/**
+ * @brief  Submission and completion queues shared with the kernel
+ *
+ * Completions are signaled through `evfd`, which is watched by the poll so
+ * a single wait covers both readiness and completion events.
+ */
+struct xring
+{
+	int fd, evfd;
+	unsigned pending;              /** SQEs queued but not yet submitted */
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_map, *cq_map;
+	size_t sq_size, cq_size, sqes_size;
+};
+
+#endif
 
 struct xpoll
 {
@@ -16,12 +45,18 @@ struct xpoll
 	sigset_t sigset;
 	int fd;
 #if HAS_KQUEUE
-	uint16_t rpos, rlen, wpos;
-	struct kevent events[64];
+	uint16_t rpos, rlen, wpos, size;
+	struct kevent *events;         /** results followed by pending changes */
 #elif HAS_EPOLL
 	int sigfd, evfd;
-	uint16_t rpos, rlen;
-	struct epoll_event events[64];
+# if HAS_EPOLL_PWAIT2
+	bool pwait2;                   /** the kernel takes nanosecond timeouts */
+# endif
+	uint16_t rpos, rlen, size;
+	struct epoll_event *events;    /** results of the last wait */
+# if HAS_IO_URING
+	struct xring ring;
+# endif
 #endif
 };
 
@@ -31,3 +66,65 @@ xpoll_init(struct xpoll *poll);
 XLOCAL void
 xpoll_final(struct xpoll *poll);
 
+/**
+ * @brief  Reads the next event already buffered by the poller
+ *
+ * Unlike `xpoll_wait`, this never requests more events from the kernel and
+ * does not update the poll clock.
+ *
+ * @param  poll  poll pointer
+ * @param[out]  ev  event information if successful
+ * @return  1 on sucess, 0 if no events are buffered, -errno on error
+ */
+XLOCAL int
+xpoll_next(struct xpoll *poll, struct xevent *ev);
+
+#if HAS_IO_URING
+
+/**
+ * @brief  Checks if the poll was able to set up an io_uring instance
+ *
+ * @param  poll  poll pointer
+ * @return  true if SQEs may be queued
+ */
+XLOCAL bool
+xpoll_has_ring(const struct xpoll *poll);
+
+/**
+ * @brief  Gets a zeroed SQE to queue an operation
+ *
+ * The SQE is submitted by the next `xpoll_wait` or `xpoll_reap`. If fewer
+ * than `n` slots are free, queued entries are submitted first so that `n`
+ * linked entries may be acquired without a submission in between.
+ *
+ * @param  poll  poll pointer
+ * @param  n     number of consecutive entries needed
+ * @return  SQE pointer or NULL on error
+ */
+XLOCAL struct io_uring_sqe *
+xpoll_sqe(struct xpoll *poll, unsigned n);
+
+/**
+ * @brief  Queues a cancellation for an operation
+ *
+ * @param  poll   poll pointer
+ * @param  udata  user data of the operation to cancel
+ * @return  0 on success, -errno on error
+ */
+XLOCAL int
+xpoll_cancel(struct xpoll *poll, uint64_t udata);
+
+/**
+ * @brief  Submits queued entries and invokes `fn` for each completion
+ *
+ * @param  poll  poll pointer
+ * @param  wait  block until at least one completion is available
+ * @param  fn    completion callback
+ * @param  data  user pointer passed to `fn`
+ * @return  number of completions, or -errno on error
+ */
+XLOCAL int
+xpoll_reap(struct xpoll *poll, bool wait,
+		void (*fn)(uint64_t udata, int32_t res, void *data), void *data);
+
+#endif
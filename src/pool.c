@@ -0,0 +1,415 @@
+#include "hub.h"
+#include "../include/crux.h"
+#include "../include/crux/err.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <assert.h>
+
+/**
+ * @brief  Pins the calling thread to one of the CPUs it is allowed to use
+ *
+ * @param  idx  index of the pool member
+ */
+static void
+pin_thread(int idx)
+{
+#if HAS_AFFINITY
+	cpu_set_t avail, set;
+	if (sched_getaffinity(0, sizeof(avail), &avail) < 0) { return; }
+
+	int n = CPU_COUNT(&avail);
+	if (n <= 1) { return; }
+
+	int want = idx % n;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &avail) && want-- == 0) {
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			return;
+		}
+	}
+#else
+	(void)idx;
+#endif
+}
+
+/**
+ * @brief  Blocks asynchronous signals for the calling thread
+ *
+ * Signals are only consumed by the hub that registered them with `xsignal`.
+ * Any thread in the pool that leaves a signal unblocked could otherwise be
+ * selected for delivery and run the default action.
+ *
+ * @param[out]  old  previous signal mask
+ */
+static void
+block_signals(sigset_t *old)
+{
+	sigset_t mask;
+	sigfillset(&mask);
+	sigdelset(&mask, SIGSEGV);
+	sigdelset(&mask, SIGBUS);
+	sigdelset(&mask, SIGFPE);
+	sigdelset(&mask, SIGILL);
+	sigdelset(&mask, SIGTRAP);
+	sigdelset(&mask, SIGABRT);
+	pthread_sigmask(SIG_BLOCK, &mask, old);
+}
+
+int
+xhub_pool_new(struct xhub_pool **poolp, int nhubs)
+{
+	assert(poolp != NULL);
+
+	if (nhubs <= 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		nhubs = n > 0 ? (int)n : 1;
+	}
+
+	struct xhub_pool *pool = malloc(sizeof(*pool) + nhubs*sizeof(pool->hubs[0]));
+	if (pool == NULL) {
+		return xerrno;
+	}
+
+	pool->running = false;
+	pool->nbusy = 0;
+	pool->nhubs = 0;
+
+	for (int i = 0; i < nhubs; i++) {
+		struct xhub *hub;
+		int rc = xhub_new(&hub);
+		if (rc < 0) {
+			xhub_pool_free(&pool);
+			return rc;
+		}
+		hub->pool = pool;
+		hub->pool_idx = i;
+		pool->hubs[pool->nhubs++] = hub;
+	}
+
+	*poolp = pool;
+	return 0;
+}
+
+void
+xhub_pool_free(struct xhub_pool **poolp)
+{
+	assert(poolp != NULL);
+
+	struct xhub_pool *pool = *poolp;
+	if (pool != NULL) {
+		*poolp = NULL;
+		for (int i = 0; i < pool->nhubs; i++) {
+			xhub_free(&pool->hubs[i]);
+		}
+		free(pool);
+	}
+}
+
+static void *
+run_member(void *data)
+{
+	struct xhub *hub = data;
+
+	xinit_thread();
+	pin_thread(hub->pool_idx);
+
+	// a stopped hub returns 1 but the pool only reports errors
+	int rc = xhub_run(hub);
+	if (rc < 0) {
+		xhub_pool_stop(hub->pool);
+	}
+	else {
+		rc = 0;
+	}
+	return (void *)(intptr_t)rc;
+}
+
+int
+xhub_pool_run(struct xhub_pool *pool)
+{
+	assert(pool != NULL);
+
+	if (atomic_exchange(&pool->running, true)) {
+		return xerr_sys(EPERM);
+	}
+
+	pthread_t *threads = calloc(pool->nhubs, sizeof(*threads));
+	if (threads == NULL) {
+		pool->running = false;
+		return xerrno;
+	}
+
+	sigset_t sigold;
+	block_signals(&sigold);
+
+#if HAS_AFFINITY
+	cpu_set_t cpuold;
+	bool restore = sched_getaffinity(0, sizeof(cpuold), &cpuold) == 0;
+#endif
+
+	int rc = 0, n;
+	for (n = 1; n < pool->nhubs; n++) {
+		int err = pthread_create(&threads[n], NULL, run_member, pool->hubs[n]);
+		if (err != 0) {
+			rc = xerr_sys(err);
+			xhub_pool_stop(pool);
+			break;
+		}
+	}
+
+	// the calling thread runs the first member
+	if (rc == 0) {
+		rc = (int)(intptr_t)run_member(pool->hubs[0]);
+	}
+
+	for (int i = 1; i < n; i++) {
+		void *res;
+		pthread_join(threads[i], &res);
+		if (rc == 0) { rc = (int)(intptr_t)res; }
+	}
+
+#if HAS_AFFINITY
+	if (restore) {
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuold), &cpuold);
+	}
+#endif
+	pthread_sigmask(SIG_SETMASK, &sigold, NULL);
+	free(threads);
+
+	for (int i = 0; i < pool->nhubs; i++) {
+		pool->hubs[i]->pool_done = false;
+	}
+	pool->running = false;
+
+	return rc;
+}
+
+void
+xhub_pool_stop(struct xhub_pool *pool)
+{
+	assert(pool != NULL);
+
+	pool->running = false;
+	for (int i = 0; i < pool->nhubs; i++) {
+		pool->hubs[i]->running = false;
+		xhub_poke(pool->hubs[i]);
+	}
+}
+
+int
+xhub_pool_size(const struct xhub_pool *pool)
+{
+	assert(pool != NULL);
+
+	return pool->nhubs;
+}
+
+struct xhub *
+xhub_pool_get(struct xhub_pool *pool, int idx)
+{
+	assert(pool != NULL);
+
+	return idx >= 0 && idx < pool->nhubs ? pool->hubs[idx] : NULL;
+}
+
+/**
+ * @brief  Selects the member with the fewest live and queued tasks
+ *
+ * The hub of the calling thread wins ties so that spawning stays local when
+ * the load is already balanced.
+ *
+ * @param  pool  pool pointer
+ * @return  hub pointer
+ */
+static struct xhub *
+least_loaded(struct xhub_pool *pool)
+{
+	struct xhub *best = xhub_current();
+	if (best != NULL && best->pool != pool) { best = NULL; }
+
+	unsigned min = best ? atomic_load(&best->nload) : UINT_MAX;
+	for (int i = 0; i < pool->nhubs && min > 0; i++) {
+		struct xhub *hub = pool->hubs[i];
+		if (hub->pool_done) { continue; }
+		unsigned n = atomic_load(&hub->nload);
+		if (n < min) {
+			best = hub;
+			min = n;
+		}
+	}
+
+	return best ? best : pool->hubs[0];
+}
+
+int
+xhub_pool_spawnf(struct xhub_pool *pool, int idx, const char *file, int line,
+		void (*fn)(struct xhub *, union xvalue), union xvalue val)
+{
+	assert(pool != NULL);
+
+	struct xhub_spawn req = {
+		.fn = fn,
+		.val = val,
+		.file = file,
+		.line = line,
+	};
+	xhub_inherit(&req);
+	return xhub_pool_submit(pool, idx, &req);
+}
+
+int
+xhub_pool_submit(struct xhub_pool *pool, int idx, const struct xhub_spawn *req)
+{
+	if (idx >= pool->nhubs) {
+		return xerr_sys(EINVAL);
+	}
+
+	struct xhub *hub = idx < 0 ? least_loaded(pool) : pool->hubs[idx];
+	if (hub == xhub_current()) {
+		return xhub_spawn_local(hub, req, false);
+	}
+
+	struct xhub_spawn *copy = malloc(sizeof(*copy));
+	if (copy == NULL) {
+		return xerrno;
+	}
+	*copy = *req;
+	copy->pinned = idx >= 0;
+
+	atomic_fetch_add(&hub->nload, 1);
+	xhub_pool_busy(pool, 1);
+
+	pthread_mutex_lock(&hub->lock);
+	xlist_add(&hub->inbox, &copy->link, X_ASCENDING);
+	atomic_fetch_add(&hub->nqueued, 1);
+	pthread_mutex_unlock(&hub->lock);
+
+	xhub_poke(hub);
+	return 0;
+}
+
+void
+xhub_pool_busy(struct xhub_pool *pool, int delta)
+{
+	unsigned n = atomic_fetch_add(&pool->nbusy, (unsigned)delta) + (unsigned)delta;
+	if (n == 0) {
+		// wake any idle siblings so they can notice that the pool is done
+		for (int i = 0; i < pool->nhubs; i++) {
+			xhub_poke(pool->hubs[i]);
+		}
+	}
+}
+
+bool
+xhub_pool_active(const struct xhub_pool *pool)
+{
+	return atomic_load(&pool->running) && atomic_load(&pool->nbusy) > 0;
+}
+
+/**
+ * @brief  Turns a queued request into a task on the hub
+ *
+ * The request has already been counted against the hub. If the task cannot
+ * be created, the count is released and the request is dropped.
+ *
+ * @param  hub  hub pointer
+ * @param  req  request to spawn and free
+ */
+static void
+spawn_request(struct xhub *hub, struct xhub_spawn *req)
+{
+	if (xhub_spawn_local(hub, req, true) < 0) {
+		atomic_fetch_sub(&hub->nload, 1);
+		xhub_pool_busy(hub->pool, -1);
+	}
+	free(req);
+}
+
+int
+xhub_pool_drain(struct xhub *hub)
+{
+	if (atomic_load(&hub->nqueued) == 0) {
+		return 0;
+	}
+
+	struct xlist tmp, *elem;
+
+	pthread_mutex_lock(&hub->lock);
+	xlist_replace(&tmp, &hub->inbox);
+	atomic_store(&hub->nqueued, 0);
+	pthread_mutex_unlock(&hub->lock);
+
+	int n = 0;
+	xlist_each(&tmp, elem, X_ASCENDING) {
+		spawn_request(hub, xcontainer(elem, struct xhub_spawn, link));
+		n++;
+	}
+	return n;
+}
+
+int
+xhub_pool_steal(struct xhub *hub)
+{
+	struct xhub_pool *pool = hub->pool;
+	struct xhub *victim = NULL;
+	unsigned max = 0;
+
+	for (int i = 0; i < pool->nhubs; i++) {
+		struct xhub *sib = pool->hubs[i];
+		if (sib == hub) { continue; }
+		unsigned n = atomic_load(&sib->nqueued);
+		if (n > max) {
+			victim = sib;
+			max = n;
+		}
+	}
+
+	if (victim == NULL) {
+		return 0;
+	}
+
+	// take up to half of the unpinned requests in arrival order
+	struct xlist tmp, *elem;
+	unsigned take = (max + 1) / 2;
+	int n = 0;
+
+	xlist_init(&tmp);
+
+	pthread_mutex_lock(&victim->lock);
+	xlist_each(&victim->inbox, elem, X_ASCENDING) {
+		if (xcontainer(elem, struct xhub_spawn, link)->pinned) { continue; }
+		xlist_del(elem);
+		xlist_add(&tmp, elem, X_ASCENDING);
+		n++;
+		if (--take == 0) { break; }
+	}
+	atomic_fetch_sub(&victim->nqueued, n);
+	pthread_mutex_unlock(&victim->lock);
+
+	atomic_fetch_sub(&victim->nload, n);
+	atomic_fetch_add(&hub->nload, n);
+
+	xlist_each(&tmp, elem, X_ASCENDING) {
+		spawn_request(hub, xcontainer(elem, struct xhub_spawn, link));
+	}
+	return n;
+}
+
+void
+xhub_pool_clear(struct xhub *hub)
+{
+	struct xlist *elem;
+
+	pthread_mutex_lock(&hub->lock);
+	xlist_each(&hub->inbox, elem, X_ASCENDING) {
+		xlist_del(elem);
+		free(xcontainer(elem, struct xhub_spawn, link));
+	}
+	atomic_store(&hub->nqueued, 0);
+	pthread_mutex_unlock(&hub->lock);
+}
@@ -14,6 +14,13 @@
 #include <dlfcn.h>
 #include <assert.h>
 
+#if defined(__SANITIZE_ADDRESS__)
+# include <sanitizer/asan_interface.h>
+# define UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION(p, n)
+#else
+# define UNPOISON(p, n) ((void)(p), (void)(n))
+#endif
+
 #if HAS_X86_64
 # include "ctx/x86_64.c"
 #elif HAS_X86_32
@@ -21,6 +28,11 @@
 #endif
 
 #define MAP_FLAGS (MAP_ANON|MAP_PRIVATE)
+#define SWITCH_STACK XSTACK_MIN
+#define ARENA_CHUNK 4096
+#define HUGE_PAGE (UINT32_C(2) << 20)
+#define CANARY_BYTE 0xa5
+#define CANARY (UINTPTR_MAX / 0xff * CANARY_BYTE)
 
 /**
  * @brief  Gets the task local storage
@@ -69,6 +81,9 @@ struct xtask {
 	struct xmgr *mgr;              /** task manager for this task */
 	struct xdefer *defer;          /** defered execution linked list */
 	struct xctx ctx;               /** execution registers */
+	struct xshared *shared;        /** execution stack if the manager shares them */
+	uint8_t *saved;                /** live stack while another task has it */
+	size_t saved_len, saved_cap;
 #if HAS_DLADDR
 	const char *entry;             /** entry function name */
 #endif
@@ -77,9 +92,32 @@ struct xtask {
 	int16_t exitcode;              /** code if in EXIT state */
 	uint8_t state;                 /** SUSPENDED, CURRENT, ACTIVE, or EXIT */
 	bool istop;
+	bool painted;                  /** stack was filled with the canary */
+	uint8_t *arena, *arena_end;    /** free space for `xmalloc` */
+	struct xchunk *chunks;         /** arena chunks to free at exit */
 } __attribute__ ((aligned(16)));
 
+/**
+ * @brief  Heap block for task allocations that don't fit the current chunk
+ */
+struct xchunk {
+	struct xchunk *next;
+} __attribute__ ((aligned(16)));
+
+/**
+ * @brief  Execution stack shared by the tasks of an `XTASK_FSHARED` manager
+ *
+ * Only the owner's frames are on the stack. Other suspended tasks keep a
+ * copy of their live frames that is put back before they run again.
+ */
+struct xshared {
+	uint8_t *map;                  /** mapping including any guard page */
+	uint8_t *top;                  /** end of the stack */
+	struct xtask *owner;           /** task with its frames on the stack */
+};
+
 static thread_local struct xtask *current = NULL;
+static thread_local struct xctx relocate_ctx;
 static thread_local struct xtask top = {
 #if HAS_DLADDR
 	.entry = "main",
@@ -88,6 +126,370 @@ static thread_local struct xtask top = {
 	.istop = true
 };
 
+/**
+ * @brief  Gets the start of the mapping that holds a task
+ *
+ * @param  t         task pointer
+ * @param  map_size  mapping size of the task manager
+ * @return  mapping address
+ */
+#define MAP(t, map_size) \
+	((uint8_t *)(void *)(t) + sizeof(struct xtask) - (map_size))
+
+/**
+ * @brief  Maps a batch of task mappings to carve new tasks from
+ *
+ * Each task mapping in the slab can still be unmapped on its own. Guard
+ * pages are all protected up front so a new task costs no system calls
+ * until the slab runs out. With `XTASK_FHUGE`, the slab is aligned to and
+ * sized in huge pages and the tasks are packed without guard pages, which
+ * would otherwise split them.
+ *
+ * @param  mgr  task manager
+ * @return  0 on success, -errno on error
+ */
+static int
+new_slab(struct xmgr *mgr)
+{
+	size_t map_size = mgr->map_size;
+	size_t n = XMGR_SLAB_TASKS, len = n * map_size, align = 0;
+
+	if (mgr->flags & XTASK_FHUGE) {
+		len = ((len - 1) / HUGE_PAGE + 1) * HUGE_PAGE;
+		n = len / map_size;
+		align = HUGE_PAGE;
+	}
+
+	uint8_t *map = mmap(NULL, len + align, PROT_READ|PROT_WRITE, MAP_FLAGS, -1, 0);
+	if (map == MAP_FAILED) { return xerrno; }
+
+	if (align) {
+		uint8_t *start = (uint8_t *)(((uintptr_t)map + align - 1) & ~((uintptr_t)align - 1));
+		if (start > map) { munmap(map, start - map); }
+		munmap(start + len, map + align - start);
+		map = start;
+#ifdef MADV_HUGEPAGE
+		madvise(map, len, MADV_HUGEPAGE);
+#endif
+	}
+
+	// whatever is left after the last whole task mapping is never used
+	if (len > n * map_size) {
+		munmap(map + n * map_size, len - n * map_size);
+		len = n * map_size;
+	}
+
+	if (mgr->flags & XTASK_FPROTECT) {
+		for (size_t i = 0; i < n; i++) {
+			if (mprotect(map + i * map_size, xpagesize, PROT_NONE) < 0) {
+				int rc = xerrno;
+				munmap(map, len);
+				return rc;
+			}
+		}
+	}
+
+	mgr->slab = map;
+	mgr->slab_left = n;
+	return 0;
+}
+
+/**
+ * @brief  Maps the memory for a new task
+ *
+ * @param  mgr       task manager
+ * @param[out]  tp   task pointer at the top of the mapping
+ * @param  prefault  fault in the whole stack now
+ * @return  0 on success, -errno on error
+ */
+static int
+map_task(struct xmgr *mgr, struct xtask **tp, bool prefault)
+{
+	size_t map_size = mgr->map_size;
+
+	// shared stack tasks only hold the task object and local storage
+	if (mgr->shared) {
+		uint8_t *p = aligned_alloc(16, map_size);
+		if (p == NULL) { return xerrno; }
+		if (prefault) { memset(p, 0, map_size); }
+		struct xtask *t = (struct xtask *)(void *)(p + map_size - sizeof(struct xtask));
+		t->saved = NULL;
+		t->saved_cap = 0;
+		*tp = t;
+		return 0;
+	}
+
+	if (mgr->slab_left == 0) {
+		int rc = new_slab(mgr);
+		if (rc < 0) { return rc; }
+	}
+
+	uint8_t *map = mgr->slab;
+	mgr->slab += map_size;
+	mgr->slab_left--;
+
+	// the addresses may have held an unmapped task's stack frames
+	UNPOISON(map, map_size);
+
+	if (prefault) {
+		size_t off = (mgr->flags & XTASK_FPROTECT) ? xpagesize : 0;
+		for (; off < map_size; off += xpagesize) {
+			map[off] = 0;
+		}
+	}
+
+	*tp = (struct xtask *)(void *)(map + map_size - sizeof(struct xtask));
+	return 0;
+}
+
+static void
+unmap_task(struct xmgr *mgr, struct xtask *t)
+{
+	if (mgr->shared) {
+		free(t->saved);
+		free(MAP(t, mgr->map_size));
+	}
+	else {
+		munmap(MAP(t, mgr->map_size), mgr->map_size);
+	}
+}
+
+static void
+unmap_tasks(struct xmgr *mgr, struct xtask *t)
+{
+	while (t != NULL) {
+		struct xtask *next = t->parent;
+		unmap_task(mgr, t);
+		t = next;
+	}
+}
+
+/**
+ * @brief  Keeps a finished task for reuse according to the watermarks
+ *
+ * Up to the low watermark, tasks stay resident. Past that, the stack pages
+ * are given back to the kernel while the mapping is kept, so reuse costs
+ * page faults but no system calls. Past the high watermark, the task is
+ * unmapped.
+ *
+ * @param  mgr  task manager
+ * @param  t    finished task
+ */
+static void
+cache_task(struct xmgr *mgr, struct xtask *t)
+{
+	if (mgr->nfree_task < mgr->free_low) {
+		t->parent = mgr->free_task;
+		mgr->free_task = t;
+		mgr->nfree_task++;
+		return;
+	}
+
+	// without a stack of its own there is nothing to release but the task
+	uint8_t *map = MAP(t, mgr->map_size);
+	if (mgr->shared || mgr->nfree_task + mgr->nfree_cold >= mgr->free_high) {
+		unmap_task(mgr, t);
+		return;
+	}
+
+	// the page holding the task object and local storage stays resident
+	uint8_t *lo = map + ((mgr->flags & XTASK_FPROTECT) ? xpagesize : 0);
+	uint8_t *hi = (uint8_t *)TLS(t, mgr->tls_size);
+	hi = (uint8_t *)((uintptr_t)hi & ~((uintptr_t)xpagesize - 1));
+	if (hi > lo) {
+		int rc = -1;
+#ifdef MADV_FREE
+		// lazily freed pages are only reclaimed under memory pressure
+		rc = madvise(lo, hi - lo, MADV_FREE);
+#endif
+		if (rc < 0) { madvise(lo, hi - lo, MADV_DONTNEED); }
+	}
+
+	t->parent = mgr->free_cold;
+	mgr->free_cold = t;
+	mgr->nfree_cold++;
+}
+
+static void
+final_shared(struct xmgr *mgr)
+{
+	if (mgr->shared == NULL) { return; }
+
+	for (int i = 0; i < XMGR_SHARED_STACKS; i++) {
+		struct xshared *sh = &mgr->shared[i];
+		if (sh->map) {
+			munmap(sh->map, sh->top - sh->map);
+		}
+	}
+	free(mgr->shared);
+	free(mgr->switch_stack);
+	mgr->shared = NULL;
+	mgr->switch_stack = NULL;
+}
+
+static int
+init_shared(struct xmgr *mgr)
+{
+	size_t map_size = (((mgr->stack_size - 1) / xpagesize) + 1) * xpagesize;
+	if (mgr->flags & XTASK_FPROTECT) { map_size += xpagesize; }
+	int rc;
+
+	mgr->shared = calloc(XMGR_SHARED_STACKS, sizeof(*mgr->shared));
+	mgr->switch_stack = malloc(SWITCH_STACK);
+	if (mgr->shared == NULL || mgr->switch_stack == NULL) {
+		goto err;
+	}
+
+	for (int i = 0; i < XMGR_SHARED_STACKS; i++) {
+		struct xshared *sh = &mgr->shared[i];
+		uint8_t *map = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_FLAGS, -1, 0);
+		if (map == MAP_FAILED) { goto err; }
+		sh->map = map;
+		sh->top = map + map_size;
+		if ((mgr->flags & XTASK_FPROTECT) && mprotect(map, xpagesize, PROT_NONE) < 0) {
+			goto err;
+		}
+	}
+	return 0;
+
+err:
+	rc = xerrno;
+	final_shared(mgr);
+	return rc;
+}
+
+/**
+ * @brief  Moves a task's frames onto its shared stack and runs it
+ *
+ * This runs on the manager's switch stack since the task giving up context
+ * may be running on the stack being replaced. The current owner's frames
+ * are copied out first unless it has exited.
+ *
+ * @param  t  task to run
+ */
+static void
+relocate(struct xtask *t)
+{
+	struct xshared *sh = t->shared;
+	struct xtask *owner = sh->owner;
+	struct xctx tmp;
+
+	// instrumented frames of the previous owner leave poisoned bytes behind
+	UNPOISON(sh->map, sh->top - sh->map);
+
+	if (owner != NULL && owner->state != EXIT) {
+		uint8_t *sp = (uint8_t *)XCTX_SP(&owner->ctx);
+		size_t len = sh->top - sp;
+		if (len > owner->saved_cap) {
+			uint8_t *saved = realloc(owner->saved, len);
+			ensure(owner, saved != NULL, "failed to save shared stack");
+			owner->saved = saved;
+			owner->saved_cap = len;
+		}
+		memcpy(owner->saved, sp, len);
+		owner->saved_len = len;
+	}
+
+	if (t->saved_len > 0) {
+		memcpy(sh->top - t->saved_len, t->saved, t->saved_len);
+		t->saved_len = 0;
+	}
+	sh->owner = t;
+	xctx_swap(&tmp, &t->ctx);
+}
+
+/**
+ * @brief  Saves the current context and activates a task's context
+ *
+ * @param  from  task giving up context
+ * @param  to    task to run
+ */
+static void
+swap(struct xtask *from, struct xtask *to)
+{
+	struct xshared *sh = to->shared;
+	if (sh == NULL || sh->owner == to) {
+		xctx_swap(&from->ctx, &to->ctx);
+	}
+	else {
+		xctx_init(&relocate_ctx, to->mgr->switch_stack, SWITCH_STACK,
+				(uintptr_t)relocate, (uintptr_t)to, 0);
+		xctx_swap(&from->ctx, &relocate_ctx);
+	}
+}
+
+/**
+ * @brief  Gets the usable stack range of a task with its own mapping
+ *
+ * @param  t        task pointer
+ * @param[out]  lo  lowest address above any guard page
+ * @return  end of the stack
+ */
+static uint8_t *
+stack_range(const struct xtask *t, uint8_t **lo)
+{
+	struct xmgr *mgr = t->mgr;
+	*lo = MAP(t, mgr->map_size) + ((mgr->flags & XTASK_FPROTECT) ? xpagesize : 0);
+	return (uint8_t *)TLS(t, mgr->tls_size) - mgr->arena_size;
+}
+
+static void
+paint_stack(struct xtask *t)
+{
+	uint8_t *lo, *hi = stack_range(t, &lo);
+	UNPOISON(lo, hi - lo);
+	memset(lo, CANARY_BYTE, hi - lo);
+	t->painted = true;
+}
+
+/**
+ * @brief  Measures the deepest point a painted stack has reached
+ *
+ * @param  t  task pointer
+ * @return  bytes of stack used
+ */
+static size_t
+stack_used(const struct xtask *t)
+{
+	uint8_t *lo, *hi = stack_range(t, &lo);
+	UNPOISON(lo, hi - lo);
+	const uintptr_t *p = (const uintptr_t *)(void *)lo;
+	while ((const uint8_t *)p < hi && *p == CANARY) {
+		p++;
+	}
+	return hi - (const uint8_t *)p;
+}
+
+static void
+record_stack(struct xtask *t)
+{
+	struct xmgr *mgr = t->mgr;
+	size_t used = stack_used(t);
+	t->painted = false;
+
+	struct xstack_site *site;
+	for (site = mgr->sites; site; site = site->next) {
+		if (site->line == t->line && site->file == t->file) { break; }
+	}
+	if (site == NULL) {
+		site = calloc(1, sizeof(*site));
+		if (site == NULL) { return; }
+		site->file = t->file;
+		site->line = t->line;
+		site->next = mgr->sites;
+		mgr->sites = site;
+	}
+
+	int bucket = 0;
+	while (bucket < XSTACK_BUCKETS - 1 && used >= ((size_t)512 << bucket)) {
+		bucket++;
+	}
+	site->count++;
+	site->total += used;
+	if (used > site->max) { site->max = used; }
+	site->buckets[bucket]++;
+}
+
 int
 xmgr_new(struct xmgr **mgrp, size_t tls, size_t stack, int flags)
 {
@@ -103,26 +505,57 @@ xmgr_init(struct xmgr *mgr, size_t tls, size_t stack, int flags)
 	if (tls > XTASK_TLS_MAX) {
 		return xerr_sys(EINVAL);
 	}
+	// shared stacks hold many tasks' frames so they can't be measured
+	if ((flags & XTASK_FSHARED) && (flags & XTASK_FPROFILE)) {
+		return xerr_sys(EINVAL);
+	}
 
 	size_t tls_size, map_size;
 
 	// round task size up to nearest multiple of 16
 	tls_size = (tls + 15) & ~15;
-	// exact size would be the stack, local storage, and task object
-	map_size = stack + tls_size + sizeof(struct xtask);
-	// round up to nearest page size
-	map_size = (((map_size - 1) / xpagesize) + 1) * xpagesize;
-	// add extra locked page if requested
-	if (flags & XTASK_FPROTECT) { map_size += xpagesize; }
+	size_t arena_size = 0;
+	if (flags & XTASK_FSHARED) {
+		// the stack is mapped once for all tasks
+		map_size = tls_size + sizeof(struct xtask);
+	}
+	else {
+		// exact size would be the stack, local storage, and task object
+		map_size = stack + tls_size + sizeof(struct xtask);
+		// round up to nearest page size
+		map_size = (((map_size - 1) / xpagesize) + 1) * xpagesize;
+		// the rounding is left between the stack and local storage for the
+		// task's first allocations
+		arena_size = (map_size - stack - tls_size - sizeof(struct xtask)) & ~(size_t)15;
+		// guard pages would split the huge pages
+		if (flags & XTASK_FHUGE) { flags &= ~XTASK_FPROTECT; }
+		// add extra locked page if requested
+		if (flags & XTASK_FPROTECT) { map_size += xpagesize; }
+	}
 
 	mgr->map_size = map_size;
 	mgr->stack_size = stack;
+	mgr->arena_size = arena_size;
 	mgr->tls_size = tls_size;
 	mgr->tls_user = tls;
 	mgr->flags = flags;
 	mgr->free_defer = NULL;
 	mgr->free_task = NULL;
-
+	mgr->free_cold = NULL;
+	mgr->nfree_task = 0;
+	mgr->nfree_cold = 0;
+	mgr->free_low = XMGR_FREE_LOW;
+	mgr->free_high = XMGR_FREE_HIGH;
+	mgr->shared = NULL;
+	mgr->next_shared = 0;
+	mgr->switch_stack = NULL;
+	mgr->sites = NULL;
+	mgr->slab = NULL;
+	mgr->slab_left = 0;
+
+	if (flags & XTASK_FSHARED) {
+		return init_shared(mgr);
+	}
 	return 0;
 }
 
@@ -144,12 +577,110 @@ xmgr_final(struct xmgr *mgr)
 		free_defer = next;
 	}
 
-	struct xtask *free_task = mgr->free_task;
-	while (free_task != NULL) {
-		struct xtask *next = free_task->parent;
-		munmap(free_task, mgr->map_size);
-		free_task = next;
+	unmap_tasks(mgr, mgr->free_task);
+	unmap_tasks(mgr, mgr->free_cold);
+	mgr->free_task = NULL;
+	mgr->free_cold = NULL;
+	mgr->nfree_task = 0;
+	mgr->nfree_cold = 0;
+	final_shared(mgr);
+
+	if (mgr->slab_left > 0) {
+		munmap(mgr->slab, (size_t)mgr->slab_left * mgr->map_size);
+		mgr->slab_left = 0;
+	}
+
+	while (mgr->sites != NULL) {
+		struct xstack_site *next = mgr->sites->next;
+		free(mgr->sites);
+		mgr->sites = next;
+	}
+}
+
+int
+xmgr_watermarks(struct xmgr *mgr, unsigned low, unsigned high)
+{
+	assert(mgr != NULL);
+
+	if (low > high) {
+		return xerr_sys(EINVAL);
+	}
+
+	mgr->free_low = low;
+	mgr->free_high = high;
+
+	// trim the cache down to the new limits right away
+	struct xtask *t;
+	while (mgr->nfree_task > low && (t = mgr->free_task)) {
+		mgr->free_task = t->parent;
+		mgr->nfree_task--;
+		cache_task(mgr, t);
+	}
+	while (mgr->nfree_task + mgr->nfree_cold > high && (t = mgr->free_cold)) {
+		mgr->free_cold = t->parent;
+		mgr->nfree_cold--;
+		munmap(MAP(t, mgr->map_size), mgr->map_size);
+	}
+	return 0;
+}
+
+int
+xmgr_profile(struct xmgr *mgr, bool enable)
+{
+	assert(mgr != NULL);
+
+	if (mgr->shared) {
+		return xerr_sys(EINVAL);
+	}
+	if (enable) { mgr->flags |= XTASK_FPROFILE; }
+	else { mgr->flags &= ~XTASK_FPROFILE; }
+	return 0;
+}
+
+void
+xmgr_print_stacks(const struct xmgr *mgr, FILE *out, int indent)
+{
+	for (const struct xstack_site *site = mgr->sites; site; site = site->next) {
+		fprintf(out, "%*sstack = { site = %s:%d, count = %" PRIu64
+				", max = %zu, mean = %zu }\n",
+				indent * 2, "", site->file ? site->file : "?", site->line,
+				site->count, site->max, (size_t)(site->total / site->count));
+		for (int i = 0; i < XSTACK_BUCKETS; i++) {
+			if (site->buckets[i]) {
+				fprintf(out, "%*sstack/%zu = %" PRIu64 "\n",
+						indent * 2, "", (size_t)256 << i, site->buckets[i]);
+			}
+		}
+	}
+}
+
+void
+xmgr_print(const struct xmgr *mgr, FILE *out)
+{
+	assert(mgr != NULL);
+
+	if (out == NULL) { out = stdout; }
+
+	fprintf(out, "<crux:mgr:%p stack=%u tls=%u> {\n",
+			(void *)mgr, mgr->stack_size, mgr->tls_user);
+	xmgr_print_stacks(mgr, out, 1);
+	fprintf(out, "}\n");
+}
+
+int
+xmgr_prewarm(struct xmgr *mgr, unsigned n)
+{
+	assert(mgr != NULL);
+
+	for (unsigned i = 0; i < n; i++) {
+		struct xtask *t;
+		int rc = map_task(mgr, &t, true);
+		if (rc < 0) { return rc; }
+		t->parent = mgr->free_task;
+		mgr->free_task = t;
+		mgr->nfree_task++;
 	}
+	return 0;
 }
 
 struct xmgr *
@@ -159,6 +690,65 @@ xmgr_self(void)
 	return t ? t->mgr : NULL;
 }
 
+/**
+ * @brief  Releases all task allocations and rewinds the arena
+ *
+ * @param  t  task pointer
+ */
+static void
+arena_reset(struct xtask *t)
+{
+	struct xchunk *c = t->chunks;
+	while (c != NULL) {
+		struct xchunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	t->chunks = NULL;
+	t->arena_end = (uint8_t *)TLS(t, t->mgr->tls_size);
+	t->arena = t->arena_end - t->mgr->arena_size;
+}
+
+/**
+ * @brief  Carves an allocation out of the task's arena
+ *
+ * Allocations are aligned to 16 bytes. When the current chunk is full, a
+ * new one is started, except for large allocations that get a chunk of
+ * their own so the current one keeps its space.
+ *
+ * @param  t     task pointer
+ * @param  size  bytes to allocate
+ * @return  allocation or NULL if out of memory
+ */
+static void *
+arena_alloc(struct xtask *t, size_t size)
+{
+	if (size > SIZE_MAX - sizeof(struct xchunk) - 15) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	size = size ? (size + 15) & ~(size_t)15 : 16;
+
+	uint8_t *p = t->arena;
+	if (size <= (size_t)(t->arena_end - p)) {
+		t->arena = p + size;
+		return p;
+	}
+
+	bool own = size > ARENA_CHUNK / 4;
+	struct xchunk *c = malloc(sizeof(*c) + (own ? size : ARENA_CHUNK));
+	if (c == NULL) { return NULL; }
+	c->next = t->chunks;
+	t->chunks = c;
+
+	p = (uint8_t *)(c + 1);
+	if (!own) {
+		t->arena = p + size;
+		t->arena_end = p + ARENA_CHUNK;
+	}
+	return p;
+}
+
 /**
  * @brief  Executes end-of-life tasks
  *
@@ -173,6 +763,10 @@ eol(struct xtask *t, union xvalue val, int ec)
 	struct xdefer *def = t->defer;
 	t->defer = NULL;
 
+	if (t->painted) {
+		record_stack(t);
+	}
+
 	// prevent task from being resumed explicity
 	t->exitcode = ec;
 	t->state = EXIT;
@@ -189,6 +783,9 @@ eol(struct xtask *t, union xvalue val, int ec)
 		t->state = EXIT;
 	}
 
+	// allocations stay valid for every deferred function
+	arena_reset(t);
+
 	// disable the ability to yield
 	t->parent = NULL;
 	t->value = val;
@@ -212,7 +809,7 @@ entry(struct xtask *t, union xvalue (*fn)(void *, union xvalue))
 	eol(t, val, 0);
 	current = p;
 	p->state = CURRENT;
-	xctx_swap(&t->ctx, &p->ctx);
+	swap(t, p);
 }
 
 int
@@ -224,29 +821,39 @@ xtask_newf(struct xtask **tp, struct xmgr *mgr, void *tls,
 	assert(mgr != NULL);
 	assert(fn != NULL);
 
-	struct xtask *t = mgr->free_task;
+	struct xtask *t;
 	size_t map_size = mgr->map_size;
 	size_t tls_size = mgr->tls_size;
-	uint8_t *stack;
 
-	if (t != NULL) {
+	if ((t = mgr->free_task) != NULL) {
 		mgr->free_task = t->parent;
-		stack = (uint8_t *)(void *)t + sizeof(*t) - map_size;
+		mgr->nfree_task--;
+	}
+	else if ((t = mgr->free_cold) != NULL) {
+		mgr->free_cold = t->parent;
+		mgr->nfree_cold--;
 	}
 	else {
-		uint8_t *map = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_FLAGS, -1, 0);
-		if (map == MAP_FAILED) { return -xerrno; }
+		int rc = map_task(mgr, &t, false);
+		if (rc < 0) { return rc; }
+	}
+	if (!mgr->shared) {
+		// a cached stack still carries the redzones of its last frames
+		UNPOISON(MAP(t, map_size), map_size);
+	}
+
+	uint8_t *stack = MAP(t, map_size);
+	size_t stack_size = map_size - sizeof(*t) - tls_size - mgr->arena_size;
+	t->shared = NULL;
+	if (mgr->shared) {
+		t->shared = &mgr->shared[mgr->next_shared++ % XMGR_SHARED_STACKS];
+		t->saved_len = 0;
+		stack = t->shared->map;
+		stack_size = t->shared->top - stack;
 		if (mgr->flags & XTASK_FPROTECT) {
-			int rc = mprotect(map, xpagesize, PROT_NONE);
-			if (rc < 0) {
-				rc = xerrno;
-				munmap(map, map_size);
-				return rc;
-			}
+			stack += xpagesize;
+			stack_size -= xpagesize;
 		}
-		stack = map;
-		map += map_size;
-		t = (struct xtask *)(void *)(map - sizeof(*t));
 	}
 
 	t->value = xzero;
@@ -258,8 +865,15 @@ xtask_newf(struct xtask **tp, struct xmgr *mgr, void *tls,
 	t->exitcode = -1;
 	t->state = SUSPENDED;
 	t->istop = false;
+	t->painted = false;
+	t->chunks = NULL;
+	arena_reset(t);
+
+	if (mgr->flags & XTASK_FPROFILE) {
+		paint_stack(t);
+	}
 
-	xctx_init(&t->ctx, stack, map_size - sizeof(*t) - tls_size,
+	xctx_init(&t->ctx, stack, stack_size,
 			(uintptr_t)entry, (uintptr_t)t, (uintptr_t)fn);
 
 	if (mgr->flags & XTASK_FENTRY) {
@@ -306,9 +920,10 @@ xtask_free(struct xtask **tp)
 	*tp = NULL;
 
 	eol(t, xzero, t->exitcode);
-
-	t->parent = t->mgr->free_task;
-	t->mgr->free_task = t;
+	if (t->shared && t->shared->owner == t) {
+		t->shared->owner = NULL;
+	}
+	cache_task(t->mgr, t);
 }
 
 struct xtask *
@@ -361,7 +976,7 @@ xtask_exit(struct xtask *t, int ec)
 	if (yield) {
 		current = p;
 		p->state = CURRENT;
-		xctx_swap(&t->ctx, &p->ctx);
+		swap(t, p);
 	}
 
 	return 0;
@@ -398,6 +1013,9 @@ print_head(const struct xtask *t, FILE *out, int indent)
 	fprintf(out, " %s tls=%u",
 			state_names[t->state],
 			t->istop ? 0 : t->mgr->tls_user);
+	if (t->painted) {
+		fprintf(out, " stack=%zu", stack_used(t));
+	}
 	if (t->state == EXIT) {
 		fprintf(out, " exitcode=%d>", t->exitcode);
 	}
@@ -458,7 +1076,7 @@ xyield(union xvalue val)
 	if (p->state != EXIT) {
 		p->state = CURRENT;
 	}
-	xctx_swap(&t->ctx, &p->ctx);
+	swap(t, p);
 	return t->value;
 }
 
@@ -481,7 +1099,7 @@ xresume(struct xtask *t, union xvalue val)
 	if (p->state != EXIT) {
 		p->state = ACTIVE;
 	}
-	xctx_swap(&p->ctx, &t->ctx);
+	swap(p, t);
 
 	return t->value;
 }
@@ -566,32 +1184,30 @@ xdefer_free(void *ptr)
 	return xdefer(free_ptr, xptr(ptr));
 }
 
-static void *
-defer_free(void *ptr)
+void *
+xmalloc(size_t size)
 {
+	struct xtask *t = current;
+	ensure(NULL, t != NULL && !t->istop, "allocation attempted outside of task");
+
+	void *ptr = arena_alloc(t, size);
 	if (ptr == NULL) {
 		xerr_abort(xerrno);
 	}
-
-	int rc = xdefer(free_ptr, xptr(ptr));
-	if (rc < 0) {
-		free(ptr);
-		xerr_abort(rc);
-	}
-
 	return ptr;
 }
 
-void *
-xmalloc(size_t size)
-{
-	return defer_free(malloc(size));
-}
-
 void *
 xcalloc(size_t count, size_t size)
 {
-	return defer_free(calloc(count, size));
+	if (size > 0 && count > SIZE_MAX / size) {
+		xerr_abort(xerr_sys(ENOMEM));
+	}
+
+	// arena space is reused from earlier tasks
+	void *ptr = xmalloc(count * size);
+	memset(ptr, 0, count * size);
+	return ptr;
 }
 
 static void
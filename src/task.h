@@ -7,14 +7,41 @@ struct xdefer
 	union xvalue val;
 };
 
+struct xshared;
+
+#define XSTACK_BUCKETS 16
+
+/**
+ * @brief  Stack usage of the tasks created at one spawn site
+ */
+struct xstack_site
+{
+	struct xstack_site *next;
+	const char *file;
+	int line;
+	uint64_t count;
+	size_t max, total;
+	uint64_t buckets[XSTACK_BUCKETS]; /** bucket n counts usage in [2^(n+8), 2^(n+9)) */
+};
+
 struct xmgr
 {
 	uint32_t map_size;
 	uint32_t stack_size;
+	uint32_t arena_size;           /** spare bytes of the mapping for `xmalloc` */
 	uint16_t tls_size, tls_user;
 	int flags;
 	struct xdefer *free_defer;
-	struct xtask *free_task;
+	struct xtask *free_task;       /** finished tasks with resident stacks */
+	struct xtask *free_cold;       /** finished tasks with released stacks */
+	uint32_t nfree_task, nfree_cold;
+	uint32_t free_low, free_high;  /** watermarks for cached tasks */
+	struct xshared *shared;        /** execution stacks for `XTASK_FSHARED` */
+	uint32_t next_shared;
+	uint8_t *switch_stack;         /** stack for swapping shared stack contents */
+	struct xstack_site *sites;     /** stack usage recorded with `XTASK_FPROFILE` */
+	uint8_t *slab;                 /** next unused task mapping of the slab */
+	uint32_t slab_left;            /** task mappings left in the slab */
 };
 
 XLOCAL int
@@ -29,3 +56,6 @@ xtask_record_entry(struct xtask *t, void *fn);
 XLOCAL void
 xtask_print_val(const struct xtask *t, FILE *out, int indent);
 
+XLOCAL void
+xmgr_print_stacks(const struct xmgr *mgr, FILE *out, int indent);
+
@@ -1,8 +1,10 @@
 #include "../include/crux/vm.h"
 #include "../include/crux/err.h"
+#include "../include/crux/clock.h"
 
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 #include <sys/mman.h>
 
 #if HAS_VM_MAP
@@ -14,8 +16,8 @@
 	if ((rc = (expr)) != KERN_SUCCESS) { goto error; } \
 } while(0)
 
-int
-xvm_alloc_ring(void **const ptr, size_t sz)
+static int
+map_ring(void **const ptr, size_t sz)
 {
 	const mach_port_t port = mach_task_self();
 	vm_address_t p = 0, half;
@@ -49,8 +51,8 @@ error:
 	return xerr_kern(rc);
 }
 
-int
-xvm_dealloc_ring(void *ptr, size_t sz)
+static int
+unmap_ring(void *ptr, size_t sz)
 {
 	kern_return_t rc = vm_deallocate(mach_task_self(), (vm_address_t)ptr, 2*sz);
 	return rc == KERN_SUCCESS ? 0 : xerr_kern(rc);
@@ -94,8 +96,8 @@ open_tmp()
 }
 # endif
 
-int
-xvm_alloc_ring(void **const ptr, size_t sz)
+static int
+map_ring(void **const ptr, size_t sz)
 {
 	void *p = NULL;
 	int fd = -1, ec = 0;
@@ -132,14 +134,247 @@ error:
 	return ec;
 }
 
-int
-xvm_dealloc_ring(void *ptr, size_t sz)
+static int
+unmap_ring(void *ptr, size_t sz)
 {
 	return xvm_dealloc(ptr, 2*sz);
 }
 
 #endif
 
+#define RING_CLASSES 16
+#define RING_CACHE 32
+#define RING_IDLE_MS 1000
+
+/**
+ * @brief  Released ring kept mapped for reuse
+ *
+ * The link is stored in the ring's own memory while it sits in the pool.
+ */
+struct ring_free {
+	struct ring_free *next;
+};
+
+/**
+ * @brief  Process-wide cache of mapped rings
+ *
+ * Each class holds rings of one size, from one page up to `RING_CLASSES`
+ * pages. Larger rings are always mapped and unmapped directly.
+ */
+static struct {
+	pthread_mutex_t lock;
+	unsigned max;                  /** rings kept per class */
+	int64_t idle_ns;               /** unused time before a class is trimmed */
+	int64_t trim_ns;               /** time of the last idle check */
+	struct {
+		struct ring_free *head;
+		unsigned count;
+		int64_t used_ns;           /** time of the last take or release */
+	} classes[RING_CLASSES];
+} rings = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.max = RING_CACHE,
+	.idle_ns = X_MSEC_TO_NSEC(RING_IDLE_MS),
+};
+
+static int64_t
+now_ns(void)
+{
+	struct timespec c;
+	xclock_mono(&c);
+	return XCLOCK_NSEC(&c);
+}
+
+static int
+ring_class(size_t sz)
+{
+	size_t pages = sz / xpagesize;
+	if (pages == 0 || pages > RING_CLASSES || sz % xpagesize) {
+		return -1;
+	}
+	return (int)pages - 1;
+}
+
+/**
+ * @brief  Unlinks the rings in a class beyond the first `keep`
+ *
+ * The ring lock must be held.
+ *
+ * @return  list of the unlinked rings
+ */
+static struct ring_free *
+take_class_locked(int cls, unsigned keep)
+{
+	if (rings.classes[cls].count <= keep) {
+		return NULL;
+	}
+
+	struct ring_free **link = &rings.classes[cls].head;
+	for (unsigned i = 0; i < keep; i++) {
+		link = &(*link)->next;
+	}
+	struct ring_free *head = *link;
+	*link = NULL;
+	rings.classes[cls].count = keep;
+	return head;
+}
+
+static unsigned
+unmap_list(struct ring_free *r, size_t sz)
+{
+	unsigned n = 0;
+	while (r) {
+		struct ring_free *next = r->next;
+		unmap_ring(r, sz);
+		r = next;
+		n++;
+	}
+	return n;
+}
+
+static pthread_once_t rings_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief  Drops the rings inherited by a forked child
+ *
+ * The rings are shared mappings, so handing them out in both processes would
+ * let their buffers write into each other. The lock may have been held by a
+ * thread that doesn't exist in the child, so it is reset rather than taken.
+ */
+static void
+rings_fork_child(void)
+{
+	pthread_mutex_init(&rings.lock, NULL);
+	for (int i = 0; i < RING_CLASSES; i++) {
+		unmap_list(take_class_locked(i, 0), (size_t)(i + 1) * xpagesize);
+	}
+}
+
+static void
+rings_init(void)
+{
+	pthread_atfork(NULL, NULL, rings_fork_child);
+}
+
+/**
+ * @brief  Unmaps classes that have not been used for the idle period
+ *
+ * At most one check runs per idle period, so frequent callers only pay for
+ * reading the clock. The ring lock must be held on entry and is released.
+ */
+static void
+trim_idle_unlock(int64_t now)
+{
+	struct ring_free *idle[RING_CLASSES] = { NULL };
+
+	if (now - rings.trim_ns >= rings.idle_ns) {
+		rings.trim_ns = now;
+		for (int i = 0; i < RING_CLASSES; i++) {
+			if (rings.classes[i].head && now - rings.classes[i].used_ns >= rings.idle_ns) {
+				idle[i] = take_class_locked(i, 0);
+			}
+		}
+	}
+	pthread_mutex_unlock(&rings.lock);
+
+	for (int i = 0; i < RING_CLASSES; i++) {
+		unmap_list(idle[i], (size_t)(i + 1) * xpagesize);
+	}
+}
+
+int
+xvm_alloc_ring(void **const ptr, size_t sz)
+{
+	int cls = ring_class(sz);
+	if (cls < 0) {
+		return map_ring(ptr, sz);
+	}
+
+	int64_t now = now_ns();
+	pthread_mutex_lock(&rings.lock);
+	struct ring_free *r = rings.classes[cls].head;
+	if (r) {
+		rings.classes[cls].head = r->next;
+		rings.classes[cls].count--;
+	}
+	rings.classes[cls].used_ns = now;
+	trim_idle_unlock(now);
+
+	if (r) {
+		*ptr = r;
+		return 0;
+	}
+	return map_ring(ptr, sz);
+}
+
+int
+xvm_dealloc_ring(void *ptr, size_t sz)
+{
+	int cls = ring_class(sz);
+	if (cls < 0) {
+		return unmap_ring(ptr, sz);
+	}
+
+	// nothing can be inherited until the first ring is pooled
+	pthread_once(&rings_once, rings_init);
+
+	int64_t now = now_ns();
+	pthread_mutex_lock(&rings.lock);
+	bool keep = rings.classes[cls].count < rings.max;
+	if (keep) {
+		struct ring_free *r = ptr;
+		r->next = rings.classes[cls].head;
+		rings.classes[cls].head = r;
+		rings.classes[cls].count++;
+	}
+	rings.classes[cls].used_ns = now;
+	trim_idle_unlock(now);
+
+	return keep ? 0 : unmap_ring(ptr, sz);
+}
+
+int
+xvm_ring_config(unsigned max, int idlems)
+{
+	if (idlems < 1) {
+		return xerr_sys(EINVAL);
+	}
+
+	struct ring_free *surplus[RING_CLASSES];
+
+	// a lowered limit applies to the rings already pooled
+	pthread_mutex_lock(&rings.lock);
+	rings.max = max;
+	rings.idle_ns = X_MSEC_TO_NSEC((int64_t)idlems);
+	for (int i = 0; i < RING_CLASSES; i++) {
+		surplus[i] = take_class_locked(i, max);
+	}
+	pthread_mutex_unlock(&rings.lock);
+
+	for (int i = 0; i < RING_CLASSES; i++) {
+		unmap_list(surplus[i], (size_t)(i + 1) * xpagesize);
+	}
+	return 0;
+}
+
+unsigned
+xvm_ring_trim(void)
+{
+	struct ring_free *all[RING_CLASSES];
+
+	pthread_mutex_lock(&rings.lock);
+	for (int i = 0; i < RING_CLASSES; i++) {
+		all[i] = take_class_locked(i, 0);
+	}
+	pthread_mutex_unlock(&rings.lock);
+
+	unsigned n = 0;
+	for (int i = 0; i < RING_CLASSES; i++) {
+		n += unmap_list(all[i], (size_t)(i + 1) * xpagesize);
+	}
+	return n;
+}
+
 #define MAP(addr, size, flags) \
 	mmap((addr), (size), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON|(flags), -1, 0)
 
@@ -0,0 +1,181 @@
+#include "wheel.h"
+#include "../include/crux/err.h"
+
+#include <assert.h>
+
+#define MASK (XWHEEL_SLOTS - 1)
+#define HORIZON_BITS (XWHEEL_LEVELS * XWHEEL_BITS)
+
+static inline unsigned
+digit(uint64_t tick, int level)
+{
+	return (tick >> (level * XWHEEL_BITS)) & MASK;
+}
+
+static void
+place(struct xwheel *wheel, struct xwheel_entry *ent)
+{
+	if (ent->tick <= wheel->now) {
+		ent->slot = -1;
+		xlist_add(&wheel->due, &ent->link, X_ASCENDING);
+		return;
+	}
+
+	int level = (63 - __builtin_clzll(ent->tick ^ wheel->now)) / XWHEEL_BITS;
+	unsigned s = digit(ent->tick, level);
+
+	assert(level < XWHEEL_LEVELS);
+
+	ent->slot = level * XWHEEL_SLOTS + s;
+	xlist_add(&wheel->slots[ent->slot], &ent->link, X_ASCENDING);
+	wheel->occupied[level] |= UINT64_C(1) << s;
+}
+
+void
+xwheel_init(struct xwheel *wheel, uint64_t now)
+{
+	wheel->now = now;
+	wheel->count = 0;
+	xlist_init(&wheel->due);
+	for (int i = 0; i < XWHEEL_LEVELS; i++) {
+		wheel->occupied[i] = 0;
+	}
+	for (int i = 0; i < XWHEEL_LEVELS * XWHEEL_SLOTS; i++) {
+		xlist_init(&wheel->slots[i]);
+	}
+}
+
+int
+xwheel_add(struct xwheel *wheel, struct xwheel_entry *ent, uint64_t tick)
+{
+	assert(wheel != NULL);
+	assert(!xwheel_is_added(ent));
+
+	if (tick > wheel->now && ((tick ^ wheel->now) >> HORIZON_BITS) != 0) {
+		return xerr_sys(ERANGE);
+	}
+
+	ent->tick = tick;
+	place(wheel, ent);
+	wheel->count++;
+	return 0;
+}
+
+void
+xwheel_remove(struct xwheel *wheel, struct xwheel_entry *ent)
+{
+	assert(wheel != NULL);
+	assert(xwheel_is_added(ent));
+
+	xlist_del(&ent->link);
+	if (ent->slot >= 0 && xlist_is_empty(&wheel->slots[ent->slot])) {
+		wheel->occupied[ent->slot / XWHEEL_SLOTS] &=
+			~(UINT64_C(1) << (ent->slot & MASK));
+	}
+	wheel->count--;
+}
+
+static uint64_t
+next_slot(const struct xwheel *wheel)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int level = 0; level < XWHEEL_LEVELS; level++) {
+		// every slot on a level is ahead of the current digit
+		unsigned cur = digit(wheel->now, level);
+		uint64_t mask = cur == MASK ? 0 : wheel->occupied[level] & (~UINT64_C(0) << (cur + 1));
+		if (mask == 0) { continue; }
+
+		int shift = (level + 1) * XWHEEL_BITS;
+		uint64_t tick = (wheel->now >> shift) << shift;
+		tick |= (uint64_t)__builtin_ctzll(mask) << (level * XWHEEL_BITS);
+		if (tick < best) { best = tick; }
+	}
+
+	return best;
+}
+
+void
+xwheel_advance(struct xwheel *wheel, uint64_t now)
+{
+	assert(wheel != NULL);
+
+	while (wheel->now < now) {
+		uint64_t tick = next_slot(wheel);
+		if (tick > now) {
+			wheel->now = now;
+			break;
+		}
+
+		wheel->now = tick;
+
+		// redistribute from the top so entries can fall through every level
+		for (int level = XWHEEL_LEVELS - 1; level >= 0; level--) {
+			if (tick & ((UINT64_C(1) << (level * XWHEEL_BITS)) - 1)) { continue; }
+
+			unsigned s = digit(tick, level);
+			uint64_t bit = UINT64_C(1) << s;
+			if (!(wheel->occupied[level] & bit)) { continue; }
+
+			struct xlist tmp, *elem;
+			xlist_replace(&tmp, &wheel->slots[level * XWHEEL_SLOTS + s]);
+			wheel->occupied[level] &= ~bit;
+
+			xlist_each(&tmp, elem, X_ASCENDING) {
+				xlist_del(elem);
+				place(wheel, xcontainer(elem, struct xwheel_entry, link));
+			}
+		}
+	}
+}
+
+struct xwheel_entry *
+xwheel_due(const struct xwheel *wheel)
+{
+	struct xlist *elem = xlist_first(&wheel->due, X_ASCENDING);
+	return elem ? xcontainer(elem, struct xwheel_entry, link) : NULL;
+}
+
+uint64_t
+xwheel_next(const struct xwheel *wheel)
+{
+	return xlist_is_empty(&wheel->due) ? next_slot(wheel) : wheel->now;
+}
+
+void
+xwheel_each(const struct xwheel *wheel,
+		void (*fn)(struct xwheel_entry *, void *), void *data)
+{
+	struct xlist *elem;
+
+	xlist_each(&wheel->due, elem, X_ASCENDING) {
+		fn(xcontainer(elem, struct xwheel_entry, link), data);
+	}
+	for (int i = 0; i < XWHEEL_LEVELS * XWHEEL_SLOTS; i++) {
+		xlist_each(&wheel->slots[i], elem, X_ASCENDING) {
+			fn(xcontainer(elem, struct xwheel_entry, link), data);
+		}
+	}
+}
+
+void
+xwheel_clear(struct xwheel *wheel,
+		void (*fn)(struct xwheel_entry *, void *), void *data)
+{
+	struct xlist *elem;
+
+	xlist_each(&wheel->due, elem, X_ASCENDING) {
+		xlist_del(elem);
+		if (fn) { fn(xcontainer(elem, struct xwheel_entry, link), data); }
+	}
+	for (int i = 0; i < XWHEEL_LEVELS * XWHEEL_SLOTS; i++) {
+		xlist_each(&wheel->slots[i], elem, X_ASCENDING) {
+			xlist_del(elem);
+			if (fn) { fn(xcontainer(elem, struct xwheel_entry, link), data); }
+		}
+	}
+	for (int i = 0; i < XWHEEL_LEVELS; i++) {
+		wheel->occupied[i] = 0;
+	}
+	wheel->count = 0;
+}
@@ -0,0 +1,99 @@
+#include "../include/crux/def.h"
+#include "../include/crux/list.h"
+
+#define XWHEEL_BITS 6
+#define XWHEEL_SLOTS (1 << XWHEEL_BITS)
+#define XWHEEL_LEVELS 4
+
+/**
+ * @brief  Timer handle embedded in the owning object
+ */
+struct xwheel_entry
+{
+	struct xlist link;
+	uint64_t tick;                 /** absolute expiration tick */
+	int slot;                      /** flat slot index, or -1 when due */
+};
+
+/**
+ * @brief  Hashed hierarchical timer wheel
+ *
+ * Level `n` has 64 slots that each span 64^n ticks, so four levels cover
+ * the 2^24 tick window that `now` falls in. Entries are placed on the level of the highest
+ * 6-bit digit where their tick differs from `now` and are moved down a
+ * level when their slot comes due. Both insert and remove are O(1), and a
+ * per-level occupancy mask finds the next slot without scanning.
+ */
+struct xwheel
+{
+	uint64_t now;                  /** last tick advanced to */
+	uint64_t occupied[XWHEEL_LEVELS];
+	unsigned count;
+	struct xlist due;              /** expired entries in expiration order */
+	struct xlist slots[XWHEEL_LEVELS * XWHEEL_SLOTS];
+};
+
+XLOCAL void
+xwheel_init(struct xwheel *wheel, uint64_t now);
+
+/**
+ * @brief  Adds an entry to expire at `tick`
+ *
+ * Ticks that have already passed are added directly to the due list.
+ *
+ * @param  wheel  wheel pointer
+ * @param  ent    entry that is not currently added
+ * @param  tick   absolute expiration tick
+ * @return  0 on success, `-ERANGE` if the tick is beyond the wheel horizon
+ */
+XLOCAL int
+xwheel_add(struct xwheel *wheel, struct xwheel_entry *ent, uint64_t tick);
+
+XLOCAL void
+xwheel_remove(struct xwheel *wheel, struct xwheel_entry *ent);
+
+XSTATIC inline bool
+xwheel_is_added(const struct xwheel_entry *ent)
+{
+	return xlist_is_added(&ent->link);
+}
+
+/**
+ * @brief  Moves the wheel forward and collects expired entries
+ *
+ * @param  wheel  wheel pointer
+ * @param  now    current tick
+ */
+XLOCAL void
+xwheel_advance(struct xwheel *wheel, uint64_t now);
+
+/**
+ * @brief  Gets the earliest expired entry without removing it
+ *
+ * @param  wheel  wheel pointer
+ * @return  entry pointer or NULL if none are due
+ */
+XLOCAL struct xwheel_entry *
+xwheel_due(const struct xwheel *wheel);
+
+/**
+ * @brief  Gets the next tick at which `xwheel_advance` has work to do
+ *
+ * This is either the expiration of an entry or the point where a higher
+ * level slot must be redistributed, so it never exceeds the earliest
+ * expiration.
+ *
+ * @param  wheel  wheel pointer
+ * @return  tick, `now` if entries are already due, or UINT64_MAX if empty
+ */
+XLOCAL uint64_t
+xwheel_next(const struct xwheel *wheel);
+
+XLOCAL void
+xwheel_each(const struct xwheel *wheel,
+		void (*fn)(struct xwheel_entry *, void *), void *data);
+
+XLOCAL void
+xwheel_clear(struct xwheel *wheel,
+		void (*fn)(struct xwheel_entry *, void *), void *data);
+
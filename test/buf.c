@@ -1,5 +1,10 @@
 #include "mu.h"
 #include "../include/crux/buf.h"
+#include "../include/crux/vm.h"
+#include "../include/crux/err.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
 
 static const char str[] = 
 	"test value with some more text to help with the byte filling";
@@ -160,6 +165,94 @@ test_ring_wrap(void)
 	xbuf_free(&buf);
 }
 
+static const void *
+ring_cycle(size_t cap)
+{
+	struct xbuf *buf;
+	mu_assert_int_eq(xbuf_new(&buf, cap, true), 0);
+	const void *p = xbuf_data(buf);
+	xbuf_free(&buf);
+	return p;
+}
+
+static void
+test_ring_pool(void)
+{
+	xvm_ring_trim();
+
+	// a released ring is handed to the next buffer of the same size
+	const void *p = ring_cycle(4000);
+	mu_assert_ptr_eq(ring_cycle(4000), p);
+
+	struct xbuf *buf;
+	mu_assert_int_eq(xbuf_new(&buf, 4000, true), 0);
+	mu_assert_ptr_eq(xbuf_data(buf), p);
+	mu_assert_uint_eq(xvm_ring_trim(), 0);
+	xbuf_free(&buf);
+	mu_assert_uint_eq(xvm_ring_trim(), 1);
+
+	mu_assert_int_eq(xvm_ring_config(0, 1000), 0);
+	ring_cycle(4000);
+	mu_assert_uint_eq(xvm_ring_trim(), 0);
+
+	// an unused size is unmapped by activity on another size
+	mu_assert_int_eq(xvm_ring_config(32, 0), xerr_sys(EINVAL));
+	mu_assert_int_eq(xvm_ring_config(32, 10), 0);
+	ring_cycle(4000);
+	usleep(20000);
+	ring_cycle(8 * 4096);
+	mu_assert_uint_eq(xvm_ring_trim(), 1);
+
+	// lowering the limit unmaps the rings already pooled beyond it
+	mu_assert_int_eq(xvm_ring_config(32, 1000), 0);
+	struct xbuf *bufs[3];
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xbuf_new(&bufs[i], 4000, true), 0);
+	}
+	for (int i = 0; i < 3; i++) {
+		xbuf_free(&bufs[i]);
+	}
+	mu_assert_int_eq(xvm_ring_config(1, 1000), 0);
+	mu_assert_uint_eq(xvm_ring_trim(), 1);
+
+	// rings larger than the pooled sizes are never kept
+	ring_cycle(1 << 20);
+	mu_assert_uint_eq(xvm_ring_trim(), 0);
+
+	mu_assert_int_eq(xvm_ring_config(32, 1000), 0);
+}
+
+static void
+test_ring_fork(void)
+{
+	uint8_t *p, *q;
+
+	xvm_ring_trim();
+	mu_assert_int_eq(xvm_alloc_ring((void **)&p, xpagesize), 0);
+	memcpy(p + 64, "parent", 7);
+	mu_assert_int_eq(xvm_dealloc_ring(p, xpagesize), 0);
+
+	// a ring the child takes must not be shared with the parent's pool
+	pid_t pid = fork();
+	mu_assert_int_ge(pid, 0);
+	if (pid == 0) {
+		if (xvm_alloc_ring((void **)&q, xpagesize) < 0) { _exit(1); }
+		memcpy(q + 64, "child", 6);
+		_exit(0);
+	}
+
+	int status;
+	mu_assert_int_eq(waitpid(pid, &status, 0), pid);
+	mu_assert(WIFEXITED(status));
+	mu_assert_int_eq(WEXITSTATUS(status), 0);
+
+	mu_assert_int_eq(xvm_alloc_ring((void **)&q, xpagesize), 0);
+	mu_assert_ptr_eq(q, p);
+	mu_assert_str_eq((const char *)q + 64, "parent");
+	mu_assert_int_eq(xvm_dealloc_ring(q, xpagesize), 0);
+	mu_assert_uint_eq(xvm_ring_trim(), 1);
+}
+
 static void
 test_open(void)
 {
@@ -199,6 +292,8 @@ main(void)
 	mu_run(test_splice);
 	mu_run(test_ring);
 	mu_run(test_ring_wrap);
+	mu_run(test_ring_pool);
+	mu_run(test_ring_fork);
 	mu_run(test_open);
 }
 
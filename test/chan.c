@@ -0,0 +1,201 @@
+#include "mu.h"
+
+#include "../include/crux.h"
+#include "../include/crux/hub.h"
+#include "../include/crux/chan.h"
+
+static struct xchan *chan;
+static int total;
+
+static void
+doproduce(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	for (int i = 1; i <= val.i; i++) {
+		mu_assert_int_eq(xchan_sendv(chan, xint(i), -1), 0);
+	}
+	xchan_close(chan);
+	mu_assert_int_eq(xchan_sendv(chan, xint(0), -1), xerr_sys(EPIPE));
+}
+
+static void
+doconsume(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	union xvalue v;
+	int rc, last = 0;
+	while ((rc = xchan_recvv(chan, &v, -1)) == 0) {
+		mu_assert_int_eq(v.i, last + 1);
+		last = v.i;
+		total += v.i;
+	}
+	mu_assert_int_eq(rc, xerr_sys(EPIPE));
+}
+
+static void
+run_pipeline(size_t cap)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xchan_new(&chan, sizeof(union xvalue), cap), 0);
+	mu_assert_uint_eq(xchan_cap(chan), cap);
+
+	total = 0;
+	mu_assert_int_eq(xspawn(hub, doconsume, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, doproduce, xint(100)), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(total, 5050);
+	mu_assert_uint_eq(xchan_count(chan), 0);
+
+	xchan_free(&chan);
+	xhub_free(&hub);
+}
+
+static void
+test_unbuffered(void)
+{
+	run_pipeline(0);
+}
+
+static void
+test_buffered(void)
+{
+	run_pipeline(1);
+	run_pipeline(8);
+	run_pipeline(1000);
+}
+
+struct point {
+	int x, y, z;
+};
+
+static void
+dosend_points(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	for (int i = 0; i < 4; i++) {
+		struct point p = { i, i * 2, i * 3 };
+		mu_assert_int_eq(xchan_send(chan, &p, -1), 0);
+	}
+	// all four fit in the buffer without blocking
+	mu_assert_uint_eq(xchan_count(chan), 4);
+	xchan_close(chan);
+}
+
+static void
+dorecv_points(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	struct point p;
+	for (int i = 0; i < 4; i++) {
+		mu_assert_int_eq(xchan_recv(chan, &p, -1), 0);
+		mu_assert_int_eq(p.x, i);
+		mu_assert_int_eq(p.y, i * 2);
+		mu_assert_int_eq(p.z, i * 3);
+	}
+	mu_assert_int_eq(xchan_recv(chan, &p, -1), xerr_sys(EPIPE));
+}
+
+static void
+test_struct(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xchan_new(&chan, 0, 4), xerr_sys(EINVAL));
+	mu_assert_int_eq(xchan_new(&chan, sizeof(struct point), 4), 0);
+	mu_assert_int_eq(xspawn(hub, dosend_points, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dorecv_points, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xchan_free(&chan);
+	xhub_free(&hub);
+}
+
+static void
+dotimeout(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	union xvalue v;
+	mu_assert_int_eq(xchan_recvv(chan, &v, 10), xerr_sys(ETIMEDOUT));
+	mu_assert_int_eq(xchan_sendv(chan, xint(1), 10), xerr_sys(ETIMEDOUT));
+	// a timed out sender leaves nothing behind
+	mu_assert_int_eq(xchan_recvv(chan, &v, 0), xerr_sys(ETIMEDOUT));
+}
+
+static void
+test_timeout(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xchan_new(&chan, sizeof(union xvalue), 0), 0);
+	mu_assert_int_eq(xspawn(hub, dotimeout, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xchan_free(&chan);
+	xhub_free(&hub);
+}
+
+static int woken;
+
+static void
+dowait(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	union xvalue v;
+	mu_assert_int_eq(xchan_recvv(chan, &v, -1), xerr_sys(EPIPE));
+	woken++;
+}
+
+static void
+dofree(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	xchan_free(&chan);
+}
+
+static void
+test_free_waiting(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xchan_new(&chan, sizeof(union xvalue), 2), 0);
+
+	woken = 0;
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xspawn(hub, dowait, xzero), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, dofree, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(woken, 3);
+	mu_assert_ptr_eq(chan, NULL);
+	xhub_free(&hub);
+}
+
+static void
+test_outside(void)
+{
+	union xvalue v;
+	mu_assert_int_eq(xchan_new(&chan, sizeof(union xvalue), 1), 0);
+	mu_assert_int_eq(xchan_sendv(chan, xint(7), -1), 0);
+	mu_assert_int_eq(xchan_sendv(chan, xint(8), -1), xerr_sys(EPERM));
+	mu_assert_int_eq(xchan_recvv(chan, &v, -1), 0);
+	mu_assert_int_eq(v.i, 7);
+	mu_assert_int_eq(xchan_recvv(chan, &v, -1), xerr_sys(EPERM));
+	xchan_free(&chan);
+}
+
+int
+main(void)
+{
+	mu_init("chan");
+	mu_run(test_unbuffered);
+	mu_run(test_buffered);
+	mu_run(test_struct);
+	mu_run(test_timeout);
+	mu_run(test_free_waiting);
+	mu_run(test_outside);
+}
@@ -0,0 +1,231 @@
+#include "mu.h"
+
+#include "../include/crux.h"
+#include "../include/crux/hub.h"
+#include "../include/crux/group.h"
+
+static struct xgroup *group;
+static int total;
+static int cancelled;
+
+static int
+dosleep(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int rc = xsleep((unsigned)val.i);
+	if (rc == xerr_sys(ECANCELED)) {
+		cancelled++;
+		return rc;
+	}
+	total += val.i;
+	return 0;
+}
+
+static int
+dofail(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	mu_assert_int_eq(xsleep(5), 0);
+	return val.i;
+}
+
+static void
+dojoin(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	for (int i = 1; i <= 10; i++) {
+		mu_assert_int_eq(xgroup_spawn(group, dosleep, xint(i)), 0);
+	}
+	mu_assert_uint_eq(xgroup_count(group), 10);
+	mu_assert_int_eq(xgroup_wait(group, -1), 0);
+	mu_assert_uint_eq(xgroup_count(group), 0);
+	mu_assert_int_eq(total, 55);
+	// an empty group is done right away
+	mu_assert_int_eq(xgroup_wait(group, 0), 0);
+}
+
+static void
+test_join(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xgroup_new(&group, hub), 0);
+	total = 0;
+	mu_assert_int_eq(xspawn(hub, dojoin, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xgroup_free(&group);
+	mu_assert_ptr_eq(group, NULL);
+	xhub_free(&hub);
+}
+
+static void
+dofirst_error(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xgroup_spawn(group, dosleep, xint(5000)), 0);
+	}
+	mu_assert_int_eq(xgroup_spawn(group, dofail, xint(xerr_sys(EIO))), 0);
+	mu_assert_int_eq(xgroup_wait(group, -1), xerr_sys(EIO));
+	mu_assert_int_eq(xgroup_spawn(group, dosleep, xint(1)), xerr_sys(ECANCELED));
+	xgroup_free(&group);
+}
+
+static void
+test_first_error(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xgroup_new(&group, hub), 0);
+	cancelled = 0;
+
+	struct timespec start, end;
+	xclock_mono(&start);
+	mu_assert_int_eq(xspawn(hub, dofirst_error, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xclock_mono(&end);
+	mu_assert_int_eq(cancelled, 3);
+	mu_assert_int_lt(XCLOCK_DIFF(&end, &start, MSEC), 1000);
+	xhub_free(&hub);
+}
+
+static void
+doscope(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	struct xgroup *grp;
+	mu_assert_int_eq(xgroup_new(&grp, h), 0);
+	for (int i = 0; i < 4; i++) {
+		mu_assert_int_eq(xgroup_spawn(grp, dosleep, xint(5000)), 0);
+	}
+	mu_assert_int_eq(xgroup_wait(grp, 10), xerr_sys(ETIMEDOUT));
+	mu_assert_uint_eq(xgroup_count(grp), 4);
+	// leaving the scope cancels the stragglers
+	xgroup_free(&grp);
+}
+
+static void
+test_scope(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	cancelled = 0;
+
+	struct timespec start, end;
+	xclock_mono(&start);
+	mu_assert_int_eq(xspawn(hub, doscope, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xclock_mono(&end);
+	mu_assert_int_eq(cancelled, 4);
+	mu_assert_int_lt(XCLOCK_DIFF(&end, &start, MSEC), 1000);
+	xhub_free(&hub);
+}
+
+static void
+doother(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	mu_assert_int_eq(xgroup_spawn(group, dosleep, xint(1)), xerr_sys(EXDEV));
+}
+
+static void
+test_outside(void)
+{
+	struct xhub *hub, *other;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xhub_new(&other), 0);
+	mu_assert_int_eq(xgroup_new(&group, hub), 0);
+
+	// children may be spawned before the hub runs, but not waited on
+	total = 0;
+	mu_assert_int_eq(xgroup_spawn(group, dosleep, xint(1)), 0);
+	mu_assert_int_eq(xgroup_wait(group, -1), xerr_sys(EPERM));
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(total, 1);
+	mu_assert_int_eq(xgroup_wait(group, -1), 0);
+
+	mu_assert_int_eq(xspawn(other, doother, xzero), 0);
+	mu_assert_int_eq(xhub_run(other), 0);
+
+	xgroup_free(&group);
+	xhub_free(&other);
+	xhub_free(&hub);
+}
+
+static int pipe_fds[2];
+static int freed;
+
+static int
+doread(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	char c;
+	xread(pipe_fds[0], &c, 1, -1);
+	return 0;
+}
+
+static void
+count_freed(union xvalue val)
+{
+	(void)val;
+	freed++;
+}
+
+static void
+dojoin_read(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	xdefer(count_freed, xzero);
+	mu_assert_int_eq(xgroup_spawn(group, doread, xzero), 0);
+	// let the child start waiting first
+	mu_assert_int_eq(xsleep(1), 0);
+	xgroup_wait(group, -1);
+}
+
+static void
+dostop(struct xhub *h, union xvalue val)
+{
+	(void)val;
+	mu_assert_int_eq(xsleep(5), 0);
+	xhub_stop(h);
+}
+
+static void
+test_free_waiting(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xgroup_new(&group, hub), 0);
+	mu_assert_call(xpipe(pipe_fds));
+	freed = 0;
+
+	// freeing the polled child resumes the joiner, which must be freed too
+	mu_assert_int_eq(xspawn(hub, dojoin_read, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dostop, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 1);
+	mu_assert_uint_eq(xgroup_count(group), 1);
+	xhub_free(&hub);
+	mu_assert_int_eq(freed, 1);
+	mu_assert_uint_eq(xgroup_count(group), 0);
+	xgroup_free(&group);
+
+	xclose(pipe_fds[0]);
+	xclose(pipe_fds[1]);
+}
+
+int
+main(void)
+{
+	mu_init("group");
+	mu_run(test_join);
+	mu_run(test_first_error);
+	mu_run(test_scope);
+	mu_run(test_outside);
+	mu_run(test_free_waiting);
+}
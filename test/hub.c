@@ -2,11 +2,15 @@
 
 #include "../include/crux.h"
 #include "../include/crux/net.h"
+#include "../include/crux/chan.h"
 #include "../src/poll.h"
 
 #include <signal.h>
 #include <math.h>
 #include <arpa/inet.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 static void
 doclose(union xvalue val)
@@ -135,6 +139,87 @@ test_pipe(void)
 	xhub_free(&hub);
 }
 
+static int short_total;
+static bool short_done;
+
+static void
+doshort_write(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xwrite(val.i, "0123456789", 10, -1), 10);
+		xsleep(5);
+	}
+	xclose(val.i);
+	while (!short_done) {
+		xsleep(1);
+	}
+}
+
+static void
+doshort_read(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[64];
+	ssize_t n;
+	while ((n = xread(val.i, buf, sizeof(buf), 1000)) > 0) {
+		short_total += n;
+	}
+	mu_assert_int_eq(n, 0);
+	short_done = true;
+}
+
+static void
+test_read_short(void)
+{
+	int fds[2];
+	mu_assert_call(xpipe(fds));
+
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	// reads wait for readiness rather than going through a ring
+	xhub_set_ring(hub, false);
+	short_total = 0;
+	short_done = false;
+	mu_assert_int_eq(xspawn(hub, doshort_write, xint(fds[1])), 0);
+	mu_assert_int_eq(xspawn(hub, doshort_read, xint(fds[0])), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(short_total, 30);
+	mu_assert(short_done);
+
+	// each read after the first short one went straight to waiting
+	struct xhub_stats stats;
+	xhub_stats(hub, &stats);
+	mu_assert_uint_ge(stats.reads_saved, 2);
+
+	xhub_free(&hub);
+	xclose(fds[0]);
+}
+
+static void
+test_pipe_high(void)
+{
+	// descriptors far apart land on separate pages of the fd table
+	struct rlimit limit;
+	mu_assert_call(getrlimit(RLIMIT_NOFILE, &limit));
+	int top = limit.rlim_cur > 100000 ? 100000 : (int)limit.rlim_cur;
+	if (top < 1024) { return; }
+
+	int fds[2];
+	mu_assert_call(xpipe(fds));
+	mu_assert_call(dup2(fds[0], top - 1));
+	mu_assert_call(dup2(fds[1], top / 2));
+	close(fds[0]);
+	close(fds[1]);
+
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xspawn(hub, dowrite, xint(top / 2)), 0);
+	mu_assert_int_eq(xspawn(hub, doread, xint(top - 1)), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+}
+
 static void
 dorecv(struct xhub *h, union xvalue val)
 {
@@ -351,6 +436,1123 @@ test_wake(void)
 	mu_assert_int_eq(woke, 1);
 }
 
+static void
+closeread(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[4];
+	mu_assert_int_eq(xread(val.i, buf, sizeof(buf), 1000), 0);
+}
+
+static void
+closer(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	xsleep(5);
+	mu_assert_int_eq(xclose(val.i), 0);
+}
+
+static void
+test_close_pending(void)
+{
+	int fds[2];
+	mu_assert_call(xpipe(fds));
+
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xspawn(hub, closeread, xint(fds[0])), 0);
+	mu_assert_int_eq(xspawn(hub, closer, xint(fds[0])), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+	close(fds[1]);
+}
+
+static void
+doaccept(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	union xaddr addr;
+	char buf[8] = { 0 };
+
+	int fd = xaccept(val.i, 0, 1000, &addr);
+	mu_assert_call(fd);
+	mu_assert_int_eq(xread(fd, buf, sizeof(buf), 1000), 4);
+	mu_assert_str_eq(buf, "ping");
+	mu_assert_int_eq(xwrite(fd, "pong", 4, 1000), 4);
+	xclose(fd);
+	xclose(val.i);
+}
+
+static void
+doconnect(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	const struct sockaddr_in *dest = val.ptr;
+	char buf[8] = { 0 };
+
+	int s = xsocket(AF_INET, SOCK_STREAM);
+	mu_assert_call(s);
+	mu_assert_int_eq(xconnect(s, (const struct sockaddr *)dest, sizeof(*dest), 1000), s);
+	mu_assert_int_eq(xwrite(s, "ping", 4, 1000), 4);
+	mu_assert_int_eq(xread(s, buf, sizeof(buf), 1000), 4);
+	mu_assert_str_eq(buf, "pong");
+	mu_assert_int_eq(xread(s, buf, sizeof(buf), 1000), 0);
+	xclose(s);
+}
+
+static void
+test_tcp(void)
+{
+	struct sockaddr_in dest = {
+		.sin_family = AF_INET,
+		.sin_port = 0,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t len = sizeof(dest);
+
+	int s = xsocket(AF_INET, SOCK_STREAM);
+	mu_assert_call(s);
+	mu_assert_call(bind(s, (struct sockaddr *)&dest, sizeof(dest)));
+	mu_assert_call(listen(s, 8));
+	mu_assert_call(getsockname(s, (struct sockaddr *)&dest, &len));
+
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xspawn(hub, doaccept, xint(s)), 0);
+	mu_assert_int_eq(xspawn(hub, doconnect, xptr(&dest)), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+}
+
+static void
+batchsleep(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int *p = val.ptr;
+	mu_assert_int_eq(xsleep(5), 0);
+	(*p)++;
+}
+
+static void
+batchread(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int *fds = val.ptr;
+	char buf[1];
+	mu_assert_int_eq(xread(fds[0], buf, 1, 1000), 1);
+	xclose(fds[0]);
+	xclose(fds[1]);
+}
+
+static void
+batchwrite(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int (*fds)[2] = val.ptr;
+	xsleep(5);
+	for (int i = 0; i < 8; i++) {
+		mu_assert_int_eq(xwrite(fds[i][1], "x", 1, 1000), 1);
+	}
+}
+
+static void
+test_batch(void)
+{
+	struct xhub *hub;
+	int count = 0;
+	int fds[8][2];
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	xhub_set_batch(hub, 64);
+
+	for (int i = 0; i < 32; i++) {
+		mu_assert_int_eq(xspawn(hub, batchsleep, xptr(&count)), 0);
+	}
+	for (int i = 0; i < 8; i++) {
+		mu_assert_call(xpipe(fds[i]));
+		mu_assert_int_eq(xspawn(hub, batchread, xptr(fds[i])), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, batchwrite, xptr(fds)), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(count, 32);
+
+	struct xhub_stats stats;
+	xhub_stats(hub, &stats);
+	mu_assert_uint_gt(stats.iterations, 0);
+	mu_assert_uint_ge(stats.dispatched, 32 + 8);
+	mu_assert_uint_gt(stats.batch_max, 1);
+	mu_assert_uint_le(stats.batch_max, 64);
+
+	uint64_t total = 0;
+	for (int i = 0; i < XHUB_BATCH_BUCKETS; i++) {
+		total += stats.batch[i];
+	}
+	mu_assert_uint_eq(total, stats.iterations);
+
+	xhub_free(&hub);
+}
+
+static int closefds[2][2];
+static int closeres[2];
+
+static void
+batchcloseread(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	// readiness comes from the poll even when reads would use the ring
+	int rc = xwait(closefds[val.i][0], XPOLL_IN, 1000);
+	if (rc == 0) {
+		// the other reader's event is already in this batch
+		xclose(closefds[!val.i][0]);
+		closeres[0]++;
+	}
+	else {
+		mu_assert_int_eq(rc, xerr_io(CLOSE));
+		closeres[1]++;
+	}
+}
+
+static void
+batchclosewrite(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	xsleep(5);
+	mu_assert_int_eq(write(closefds[0][1], "x", 1), 1);
+	mu_assert_int_eq(write(closefds[1][1], "x", 1), 1);
+}
+
+static void
+test_batch_close(void)
+{
+	struct xhub *hub;
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	xhub_set_batch(hub, 64);
+
+	for (int i = 0; i < 2; i++) {
+		mu_assert_call(xpipe(closefds[i]));
+		mu_assert_int_eq(xspawn(hub, batchcloseread, xint(i)), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, batchclosewrite, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(closeres[0], 1);
+	mu_assert_int_eq(closeres[1], 1);
+
+	close(closefds[0][1]);
+	close(closefds[1][1]);
+	xhub_free(&hub);
+}
+
+static struct xchan *selchan;
+
+static void
+doselect(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int fd = val.i;
+	union xvalue msg = xzero;
+	char buf[8];
+
+	struct xselect ops[] = {
+		{ .type = XPOLL_IN, .id = fd },
+		{ .type = XSELECT_RECV, .chan = selchan, .msg = &msg },
+		{ .type = XPOLL_SIG, .id = SIGUSR1 },
+	};
+
+	// the channel fires first
+	mu_assert_int_eq(xselect(ops, xlen(ops), 1000), 1);
+	mu_assert_int_eq(ops[1].rc, 0);
+	mu_assert_int_eq(msg.i, 42);
+
+	// then the pipe
+	mu_assert_int_eq(xselect(ops, xlen(ops), 1000), 0);
+	mu_assert_int_eq(ops[0].rc, 0);
+	mu_assert_int_eq(read(fd, buf, sizeof(buf)), 4);
+
+	// then the signal
+	mu_assert_int_eq(xselect(ops, xlen(ops), 1000), 2);
+	mu_assert_int_eq(ops[2].rc, SIGUSR1);
+
+	// nothing else is pending
+	mu_assert_int_eq(xselect(ops, xlen(ops), 10), xerr_sys(ETIMEDOUT));
+
+	// a buffered message is taken without waiting
+	mu_assert_int_eq(xchan_sendv(selchan, xint(7), -1), 0);
+	mu_assert_int_eq(xselect(ops, xlen(ops), 0), 1);
+	mu_assert_int_eq(msg.i, 7);
+
+	// a closed channel fires with its error
+	mu_assert_int_eq(xselect(ops, xlen(ops), 1000), 1);
+	mu_assert_int_eq(ops[1].rc, xerr_sys(EPIPE));
+
+	struct xselect bad = { .type = XPOLL_INOUT, .id = fd };
+	mu_assert_int_eq(xselect(&bad, 1, -1), xerr_sys(EINVAL));
+
+	xclose(fd);
+}
+
+static void
+doselect_send(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	int fd = val.i;
+
+	xsleep(10);
+	mu_assert_int_eq(xchan_sendv(selchan, xint(42), -1), 0);
+	xsleep(10);
+	mu_assert_int_eq(xwrite(fd, "test", 4, -1), 4);
+	xsleep(10);
+	mu_assert_call(kill(getpid(), SIGUSR1));
+	xsleep(40);
+	xchan_close(selchan);
+	xclose(fd);
+}
+
+static void
+test_select(void)
+{
+	int fds[2];
+	mu_assert_call(xpipe(fds));
+
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xchan_new(&selchan, sizeof(union xvalue), 1), 0);
+	mu_assert_int_eq(xspawn(hub, doselect, xint(fds[0])), 0);
+	mu_assert_int_eq(xspawn(hub, doselect_send, xint(fds[1])), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xchan_free(&selchan);
+	xhub_free(&hub);
+}
+
+#define POST_THREADS 4
+#define POST_COUNT 2000
+
+static atomic_int posted;
+
+static void
+dopost(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	atomic_fetch_add(&posted, val.i);
+}
+
+static void *
+post_thread(void *data)
+{
+	for (int i = 0; i < POST_COUNT; i++) {
+		mu_assert_int_eq(xhub_post(data, dopost, xint(1)), 0);
+	}
+	return NULL;
+}
+
+static void
+dopost_wait(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	while (atomic_load(&posted) < POST_THREADS * POST_COUNT) {
+		xsleep(1);
+	}
+}
+
+static void
+test_post(void)
+{
+	struct xhub *hub;
+	pthread_t threads[POST_THREADS];
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+
+	// posts queued before the hub runs are picked up as well
+	posted = 0;
+	mu_assert_int_eq(xhub_post(hub, dopost, xint(0)), 0);
+
+	mu_assert_int_eq(xspawn(hub, dopost_wait, xzero), 0);
+	for (int i = 0; i < POST_THREADS; i++) {
+		mu_assert_int_eq(pthread_create(&threads[i], NULL, post_thread, hub), 0);
+	}
+	mu_assert_int_eq(xhub_run(hub), 0);
+	for (int i = 0; i < POST_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	mu_assert_int_eq(posted, POST_THREADS * POST_COUNT);
+
+	struct xhub_stats stats;
+	xhub_stats(hub, &stats);
+	mu_assert_uint_eq(stats.posted, POST_THREADS * POST_COUNT + 1);
+	mu_assert_uint_gt(stats.post_drains, 0);
+	mu_assert_uint_le(stats.post_drains, stats.posted);
+
+	xhub_free(&hub);
+}
+
+#define OFFLOAD_COUNT 8
+
+static int offload_ticks;
+static int offload_sum;
+static int offload_done;
+
+static int
+offload_sleep(void *data)
+{
+	usleep(20000);
+	return (int)(intptr_t)data;
+}
+
+static int
+offload_block(void *data)
+{
+	(void)data;
+	usleep(50000);
+	return 0;
+}
+
+static void
+dooffload(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	offload_sum += xhub_offload(offload_sleep, (void *)(intptr_t)val.i, -1);
+	offload_done++;
+}
+
+static void
+dooffload_timeout(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	// the worker finishes after the task has moved on
+	mu_assert_int_eq(xhub_offload(offload_sleep, NULL, 5), xerr_sys(ETIMEDOUT));
+}
+
+static void
+dooffload_tick(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	while (offload_done < OFFLOAD_COUNT) {
+		xsleep(1);
+		offload_ticks++;
+	}
+}
+
+static void
+test_offload(void)
+{
+	struct xhub *hub;
+	struct xhub_offload_stats before, after;
+
+	// no hub to keep running, so the call is made directly
+	mu_assert_int_eq(xhub_offload(offload_sleep, (void *)3, -1), 3);
+
+	mu_assert_int_eq(xhub_offload_config(0, 16), xerr_sys(EINVAL));
+	mu_assert_int_eq(xhub_offload_config(4, 64), 0);
+	xhub_offload_stats(&before);
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	offload_ticks = offload_sum = offload_done = 0;
+	for (int i = 1; i <= OFFLOAD_COUNT; i++) {
+		mu_assert_int_eq(xspawn(hub, dooffload, xint(i)), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, dooffload_timeout, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dooffload_tick, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+
+	mu_assert_int_eq(offload_sum, OFFLOAD_COUNT * (OFFLOAD_COUNT + 1) / 2);
+	// two rounds of 20ms on four workers leave plenty of time to tick
+	mu_assert_int_gt(offload_ticks, 10);
+
+	xhub_offload_stats(&after);
+	mu_assert_uint_eq(after.submitted - before.submitted, OFFLOAD_COUNT + 1);
+	mu_assert_uint_eq(after.completed - before.completed, OFFLOAD_COUNT + 1);
+	mu_assert_uint_le(after.workers, 4);
+	mu_assert_uint_eq(after.busy, 0);
+	mu_assert_uint_eq(after.queued, 0);
+	mu_assert_uint_gt(after.queued_max, 0);
+	mu_assert_uint_gt(after.busy_ns, 0);
+	mu_assert_uint_le(after.busy_ns, after.alive_ns);
+}
+
+static int
+offload_short(void *data)
+{
+	usleep((useconds_t)(intptr_t)data);
+	return 0;
+}
+
+static void
+dooffload_leave(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	// a quick call may finish before the timeout is seen
+	int rc = xhub_offload(offload_short, val.ptr, 0);
+	mu_assert(rc == 0 || rc == xerr_sys(ETIMEDOUT));
+}
+
+static void
+test_offload_free(void)
+{
+	// the hub is freed while the worker is still posting the completion
+	for (int i = 0; i < 200; i++) {
+		struct xhub *hub;
+		mu_assert_int_eq(xhub_new(&hub), 0);
+		mu_assert_int_eq(xspawn(hub, dooffload_leave, xptr((void *)(intptr_t)(i % 5 * 100))), 0);
+		mu_assert_int_eq(xhub_run(hub), 0);
+		xhub_free(&hub);
+	}
+}
+
+static struct xtask *dial_task;
+static int dial_rc[2];
+
+static void
+doblock_offload(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	mu_assert_int_eq(xhub_offload(offload_block, NULL, -1), 0);
+}
+
+static void
+dodial_cancel(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	union xaddr addr;
+	dial_task = xtask_self();
+	// the lookup waits behind the busy workers and is given up on
+	dial_rc[0] = xdial("127.0.0.1:1", SOCK_STREAM, 0, 1000, &addr);
+}
+
+static void
+dodial_scope(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	union xaddr addr;
+	struct xscope scope;
+	mu_assert_int_eq(xscope_enter(&scope, 5), 0);
+	dial_rc[1] = xdial("127.0.0.1:1", SOCK_STREAM, 0, 1000, &addr);
+	xscope_exit(&scope);
+}
+
+static void
+docancel_dial(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	mu_assert_int_eq(xsleep(5), 0);
+	mu_assert_int_eq(xtask_cancel(dial_task), 0);
+}
+
+static void
+test_offload_abandon(void)
+{
+	struct xhub *hub;
+	struct xhub_offload_stats stats;
+
+	// keep every worker busy so the lookups can't finish before the tasks
+	// give up on them
+	xhub_offload_stats(&stats);
+	mu_assert_int_eq(xhub_offload_config(stats.workers > 0 ? stats.workers : 1, 64), 0);
+	xhub_offload_stats(&stats);
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	for (unsigned i = 0; i < (stats.workers > 0 ? stats.workers : 1); i++) {
+		mu_assert_int_eq(xspawn(hub, doblock_offload, xzero), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, dodial_cancel, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dodial_scope, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, docancel_dial, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+
+	mu_assert_int_eq(dial_rc[0], xerr_sys(ECANCELED));
+	mu_assert_int_eq(dial_rc[1], xerr_sys(ETIMEDOUT));
+
+	xhub_offload_stats(&stats);
+	mu_assert_uint_eq(stats.busy, 0);
+	mu_assert_uint_eq(stats.queued, 0);
+	mu_assert_int_eq(xhub_offload_config(4, 64), 0);
+}
+
+static void
+spin(int64_t ns)
+{
+	struct timespec start, now;
+	xclock_mono(&start);
+	do {
+		xclock_mono(&now);
+	} while (XCLOCK_NSEC(&now) - XCLOCK_NSEC(&start) < ns);
+}
+
+static void
+doaccount(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	spin(X_MSEC_TO_NSEC(1));
+	mu_assert_uint_ge(xcputime(), X_MSEC_TO_NSEC(1));
+	mu_assert_int_eq(xsleep(1), 0);
+	spin(X_MSEC_TO_NSEC(1));
+	mu_assert_uint_ge(xcputime(), X_MSEC_TO_NSEC(2));
+}
+
+static void
+test_account(void)
+{
+	struct xhub *hub;
+	struct xhub_stats stats;
+	struct xhub_site sites[2];
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_uint_eq(xcputime(), 0);
+
+	// tasks spawned before accounting starts belong to no site
+	mu_assert_int_eq(xspawn(hub, doaccount, xzero), 0);
+	xhub_account(hub, true);
+	int line = __LINE__ + 2;
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xspawn(hub, doaccount, xzero), 0);
+	}
+	mu_assert_int_eq(xhub_run(hub), 0);
+
+	xhub_stats(hub, &stats);
+	mu_assert_uint_ge(stats.resumed, 8);
+	mu_assert_uint_ge(stats.run_ns, X_MSEC_TO_NSEC(8));
+	mu_assert_uint_ge(stats.run_max, X_MSEC_TO_NSEC(1));
+	mu_assert_uint_le(stats.wait_max, stats.wait_ns);
+
+	uint64_t waits = 0, runs = 0;
+	for (int i = 0; i < XHUB_TIME_BUCKETS; i++) {
+		waits += stats.wait[i];
+		runs += stats.run[i];
+	}
+	mu_assert_uint_eq(runs, stats.resumed);
+	// the tasks queued behind a spinning task waited at least as long as it ran
+	mu_assert_uint_gt(waits, 0);
+	mu_assert_uint_ge(stats.wait_max, X_MSEC_TO_NSEC(1));
+
+	mu_assert_int_eq(xhub_sites(hub, sites, 2), 1);
+	mu_assert_str_eq(sites[0].file, __FILE__);
+	mu_assert_int_eq(sites[0].line, line);
+	mu_assert_uint_eq(sites[0].tasks, 3);
+	mu_assert_uint_ge(sites[0].cpu_ns, X_MSEC_TO_NSEC(6));
+	mu_assert_uint_ge(sites[0].cpu_max, X_MSEC_TO_NSEC(2));
+
+	xhub_free(&hub);
+}
+
+static struct xtask *hedge[2];
+static int hedge_fds[2][2];
+static int hedge_rc[2];
+
+static void
+dohedge(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[1];
+	hedge[val.i] = xtask_self();
+	hedge_rc[val.i] = (int)xread(hedge_fds[val.i][0], buf, sizeof(buf), 1000);
+	// the winner cancels the loser as soon as it has an answer
+	if (hedge_rc[val.i] == 1) {
+		mu_assert_int_eq(xtask_cancel(hedge[!val.i]), 0);
+		mu_assert_int_eq(xtask_cancel(hedge[!val.i]), xerr_sys(EALREADY));
+	}
+	else {
+		// once cancelled, a task can't wait again
+		mu_assert_int_eq(xsleep(1), xerr_sys(ECANCELED));
+	}
+}
+
+static void
+doanswer(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	mu_assert_int_eq(xsleep(5), 0);
+	mu_assert_int_eq(xwrite(hedge_fds[1][1], "x", 1, 1000), 1);
+}
+
+static struct xchan *cancel_chan;
+
+static void
+dorecv_cancel(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	union xvalue v;
+	*(struct xtask **)val.ptr = xtask_self();
+	mu_assert_int_eq(xchan_recvv(cancel_chan, &v, -1), xerr_sys(ECANCELED));
+}
+
+static void
+docancel(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	struct xtask **t = val.ptr;
+	mu_assert_int_eq(xsleep(1), 0);
+	mu_assert_int_eq(xtask_cancel(t[0]), 0);
+	mu_assert_int_eq(xtask_cancel(t[1]), 0);
+}
+
+static void
+dosleep_cancel(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	*(struct xtask **)val.ptr = xtask_self();
+	mu_assert_int_eq(xsleep(5000), xerr_sys(ECANCELED));
+}
+
+static void *
+cancel_thread(void *arg)
+{
+	return (void *)(intptr_t)xtask_cancel(arg);
+}
+
+static void
+docancel_foreign(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	pthread_t thr;
+	void *rc;
+	mu_assert_int_eq(pthread_create(&thr, NULL, cancel_thread, xtask_self()), 0);
+	pthread_join(thr, &rc);
+	mu_assert_int_eq((int)(intptr_t)rc, xerr_sys(EXDEV));
+	mu_assert_int_eq(xsleep(1), 0);
+}
+
+static void
+test_cancel(void)
+{
+	struct xhub *hub;
+	struct xtask *parked[2];
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	for (int i = 0; i < 2; i++) {
+		mu_assert_int_eq(xpipe(hedge_fds[i]), 0);
+		mu_assert_int_eq(xspawn(hub, dohedge, xint(i)), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, doanswer, xzero), 0);
+
+	mu_assert_int_eq(xchan_new(&cancel_chan, sizeof(union xvalue), 0), 0);
+	mu_assert_int_eq(xspawn(hub, dorecv_cancel, xptr(&parked[0])), 0);
+	mu_assert_int_eq(xspawn(hub, dosleep_cancel, xptr(&parked[1])), 0);
+	mu_assert_int_eq(xspawn(hub, docancel, xptr(parked)), 0);
+	mu_assert_int_eq(xspawn(hub, docancel_foreign, xzero), 0);
+
+	struct timespec start, end;
+	xclock_mono(&start);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xclock_mono(&end);
+	mu_assert_int_lt(XCLOCK_DIFF(&end, &start, MSEC), 500);
+
+	mu_assert_int_eq(hedge_rc[1], 1);
+	mu_assert_int_eq(hedge_rc[0], xerr_sys(ECANCELED));
+
+	for (int i = 0; i < 2; i++) {
+		close(hedge_fds[i][0]);
+		close(hedge_fds[i][1]);
+	}
+	xchan_free(&cancel_chan);
+	xhub_free(&hub);
+}
+
+static int deadline_fds[2], child_fds[2];
+static int deadline_done;
+
+static void
+dodeadline_child(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	char buf[1];
+	// the deadline of the spawning scope carries over
+	mu_assert_int_le(xscope_remaining(), 21);
+	mu_assert_int_eq(xread(child_fds[0], buf, 1, -1), xerr_sys(ETIMEDOUT));
+	deadline_done++;
+}
+
+static void
+dodeadline(struct xhub *h, union xvalue val)
+{
+	(void)val;
+	struct xscope outer, inner;
+	char buf[4];
+
+	mu_assert_int_eq(xscope_remaining(), XTIMEOUT_NONE);
+	mu_assert_int_eq(xscope_enter(&outer, 20), 0);
+	mu_assert_int_eq(xspawn(h, dodeadline_child, xzero), 0);
+
+	// a wider scope inside doesn't extend the deadline, which is rounded up
+	// to end on a millisecond
+	mu_assert_int_eq(xscope_enter(&inner, 5000), 0);
+	mu_assert_int_le(xscope_remaining(), 21);
+	xscope_exit(&inner);
+
+	mu_assert_int_eq(xwrite(deadline_fds[1], "ab", 2, -1), 2);
+	mu_assert_int_eq(xreadn(deadline_fds[0], buf, 4, -1), xerr_sys(ETIMEDOUT));
+	mu_assert_int_eq(xsleep(1000), xerr_sys(ETIMEDOUT));
+	mu_assert_int_eq(xscope_remaining(), 0);
+	xscope_exit(&outer);
+
+	mu_assert_int_eq(xscope_remaining(), XTIMEOUT_NONE);
+	mu_assert_int_eq(xsleep(1), 0);
+	deadline_done++;
+}
+
+static void
+test_deadline(void)
+{
+	struct xhub *hub;
+	struct xscope scope;
+
+	mu_assert_int_eq(xscope_enter(&scope, 10), xerr_sys(EPERM));
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xpipe(deadline_fds), 0);
+	mu_assert_int_eq(xpipe(child_fds), 0);
+	deadline_done = 0;
+
+	struct timespec start, end;
+	xclock_mono(&start);
+	mu_assert_int_eq(xspawn(hub, dodeadline, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xclock_mono(&end);
+	mu_assert_int_eq(deadline_done, 2);
+	mu_assert_int_lt(XCLOCK_DIFF(&end, &start, MSEC), 500);
+
+	close(deadline_fds[0]);
+	close(deadline_fds[1]);
+	close(child_fds[0]);
+	close(child_fds[1]);
+	xhub_free(&hub);
+}
+
+static char prio_order[32];
+static int prio_n;
+
+static void
+doprio_mark(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	prio_order[prio_n++] = (char)val.i;
+}
+
+static void
+doprio_parent(struct xhub *h, union xvalue val)
+{
+	prio_order[prio_n++] = (char)val.i;
+	// children take the class of the task spawning them
+	mu_assert_int_eq(xspawn(h, doprio_mark, xint('c')), 0);
+}
+
+static void
+test_prio(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIOS, doprio_mark, xzero), xerr_sys(EINVAL));
+	mu_assert_int_eq(xhub_set_prio_weight(hub, -1, 1), xerr_sys(EINVAL));
+	mu_assert_int_eq(xhub_set_prio_weight(hub, XHUB_PRIO_NORMAL, 4), 0);
+
+	prio_n = 0;
+	for (int i = 0; i < 16; i++) {
+		mu_assert_int_eq(xspawn(hub, doprio_mark, xint('n')), 0);
+	}
+	mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIO_LOW, doprio_mark, xint('l')), 0);
+	mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIO_LOW, doprio_mark, xint('l')), 0);
+	mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIO_HIGH, doprio_parent, xint('h')), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(prio_n, 20);
+
+	// high tasks are strict and don't count toward the normal weight, so
+	// low ones get a turn after every four normal ones
+	mu_assert_str_eq(prio_order, "hcnnnnlnnnnlnnnnnnnn");
+	xhub_free(&hub);
+}
+
+static void
+test_prio_mixed(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xhub_set_prio_weight(hub, XHUB_PRIO_NORMAL, 2), 0);
+
+	prio_n = 0;
+	memset(prio_order, 0, sizeof(prio_order));
+	for (int i = 0; i < 2; i++) {
+		mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIO_LOW, doprio_mark, xint('l')), 0);
+	}
+	for (int i = 0; i < 6; i++) {
+		mu_assert_int_eq(xspawn(hub, doprio_mark, xint('n')), 0);
+	}
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xspawn_prio(hub, XHUB_PRIO_HIGH, doprio_mark, xint('h')), 0);
+	}
+	mu_assert_int_eq(xhub_run(hub), 0);
+	mu_assert_int_eq(prio_n, 11);
+
+	// the high burst leaves the normal class its full weight
+	mu_assert_str_eq(prio_order, "hhhnnlnnlnn");
+	xhub_free(&hub);
+}
+
+static int budget_fds[2];
+static bool budget_done;
+static int budget_ticks;
+
+static void
+dobudget_read(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	char c;
+	for (int i = 0; i < 64; i++) {
+		mu_assert_int_eq(xread(budget_fds[0], &c, 1, 1000), 1);
+	}
+	budget_done = true;
+}
+
+static void
+dobudget_tick(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	while (!budget_done) {
+		budget_ticks++;
+		mu_assert_int_eq(xwait(-1, 0, -1), 0);
+	}
+}
+
+static void
+run_budget(unsigned calls, unsigned usec)
+{
+	struct xhub *hub;
+	struct xhub_stats stats;
+	char buf[64] = { 0 };
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	// without the ring the pipe is always ready to read
+	xhub_set_ring(hub, false);
+	xhub_set_io_budget(hub, calls, usec);
+	mu_assert_int_eq(xpipe(budget_fds), 0);
+	mu_assert_int_eq(write(budget_fds[1], buf, sizeof(buf)), sizeof(buf));
+
+	budget_done = false;
+	budget_ticks = 0;
+	mu_assert_int_eq(xspawn(hub, dobudget_read, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dobudget_tick, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+
+	xhub_stats(hub, &stats);
+	if (calls == 0 && usec == 0) {
+		mu_assert_uint_eq(stats.forced_yields, 0);
+		mu_assert_int_eq(budget_ticks, 0);
+	}
+	else if (calls > 0) {
+		mu_assert_uint_eq(stats.forced_yields, 64 / calls);
+		mu_assert_int_ge(budget_ticks, 64 / calls);
+	}
+	else {
+		mu_assert_uint_gt(stats.forced_yields, 0);
+		mu_assert_int_gt(budget_ticks, 0);
+	}
+
+	close(budget_fds[0]);
+	close(budget_fds[1]);
+	xhub_free(&hub);
+}
+
+static void
+test_io_budget(void)
+{
+	run_budget(0, 0);
+	run_budget(8, 0);
+	run_budget(0, 1);
+}
+
+static int spin_fds[2];
+
+static void
+dospin_wait(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	// nothing is written yet so the spin misses and the wait blocks
+	mu_assert_int_eq(xwait(spin_fds[0], XPOLL_IN, 5), xerr_sys(ETIMEDOUT));
+	mu_assert_int_eq(xwait(spin_fds[0], XPOLL_IN, 1000), 0);
+}
+
+static void
+dospin_write(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	mu_assert_int_eq(xsleep(10), 0);
+	mu_assert_int_eq(write(spin_fds[1], "x", 1), 1);
+}
+
+static void
+test_busy_poll(void)
+{
+	struct xhub *hub;
+	struct xhub_stats stats;
+
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	xhub_set_busy_poll(hub, 1000, true);
+	mu_assert_call(socketpair(AF_UNIX, SOCK_STREAM, 0, spin_fds));
+	mu_assert_int_eq(xspawn(hub, dospin_wait, xzero), 0);
+	mu_assert_int_eq(xspawn(hub, dospin_write, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+
+	// the write is ready before the hub polls again
+	xhub_stats(hub, &stats);
+	mu_assert_uint_gt(stats.spin_hits, 0);
+	mu_assert_uint_gt(stats.spin_misses, 0);
+
+	close(spin_fds[0]);
+	close(spin_fds[1]);
+	xhub_free(&hub);
+}
+
+static void
+dospin_read(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	char buf[1];
+	// the read completes through the ring where there is one
+	mu_assert_int_eq(xread(spin_fds[0], buf, sizeof(buf), 1000), 1);
+}
+
+static void
+test_busy_poll_read(void)
+{
+#ifdef SO_BUSY_POLL
+	struct xhub *hub;
+	int usec = 0;
+	socklen_t len = sizeof(usec);
+
+	mu_assert_call(socketpair(AF_UNIX, SOCK_STREAM, 0, spin_fds));
+	// without a ring the read waits for readiness
+	mu_assert_call(xunblock(spin_fds[0]));
+
+	// raising the busy poll time may need privileges
+	if (setsockopt(spin_fds[1], SOL_SOCKET, SO_BUSY_POLL, &(int){1000}, sizeof(int)) == 0) {
+		mu_assert_int_eq(xhub_new(&hub), 0);
+		xhub_set_busy_poll(hub, 1000, true);
+		mu_assert_int_eq(xspawn(hub, dospin_read, xzero), 0);
+		mu_assert_int_eq(xspawn(hub, dospin_write, xzero), 0);
+		mu_assert_int_eq(xhub_run(hub), 0);
+		xhub_free(&hub);
+
+		mu_assert_call(getsockopt(spin_fds[0], SOL_SOCKET, SO_BUSY_POLL, &usec, &len));
+		mu_assert_int_eq(usec, 1000);
+	}
+
+	close(spin_fds[0]);
+	close(spin_fds[1]);
+#endif
+}
+
+#define FREE_READS 300
+
+static int free_fds[FREE_READS][2];
+
+static void
+dofree_read(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[1];
+	xread(free_fds[val.i][0], buf, sizeof(buf), -1);
+}
+
+static void
+dofree_stop(struct xhub *h, union xvalue val)
+{
+	(void)val;
+	mu_assert_int_eq(xsleep(5), 0);
+	xhub_stop(h);
+}
+
+static void
+test_free_reads(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+
+	// more reads than the ring has submission slots must all be cancelled
+	for (int i = 0; i < FREE_READS; i++) {
+		mu_assert_call(xpipe(free_fds[i]));
+		mu_assert_int_eq(xspawn(hub, dofree_read, xint(i)), 0);
+	}
+	mu_assert_int_eq(xspawn(hub, dofree_stop, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 1);
+	xhub_free(&hub);
+
+	for (int i = 0; i < FREE_READS; i++) {
+		close(free_fds[i][0]);
+		close(free_fds[i][1]);
+	}
+}
+
+static int64_t
+elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+	xclock_mono(&now);
+	return XCLOCK_NSEC(&now) - XCLOCK_NSEC(start);
+}
+
+static void
+dofine(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	struct timespec start;
+	struct xscope scope;
+	int fds[2];
+	char buf[1];
+
+	mu_assert_call(xpipe(fds));
+
+	xclock_mono(&start);
+	for (int i = 0; i < 20; i++) {
+		mu_assert_int_eq(xsleep_ns(250000), 0);
+	}
+	int64_t ns = elapsed_ns(&start);
+	mu_assert_int_ge(ns, 20 * 250000);
+#if HAS_EPOLL_PWAIT2
+	// millisecond timers would take at least 20ms
+	mu_assert_int_lt(ns, X_MSEC_TO_NSEC(15));
+#endif
+
+	xclock_mono(&start);
+	mu_assert_int_eq(xwait_ns(fds[0], XPOLL_IN, 300000), xerr_sys(ETIMEDOUT));
+	mu_assert_int_ge(elapsed_ns(&start), 300000);
+
+	xclock_mono(&start);
+	mu_assert_int_eq(xscope_enter_ns(&scope, 400000), 0);
+	mu_assert_int_eq(xread(fds[0], buf, 1, -1), xerr_sys(ETIMEDOUT));
+	mu_assert_int_eq(xsleep_ns(1000000), xerr_sys(ETIMEDOUT));
+	xscope_exit(&scope);
+	mu_assert_int_ge(elapsed_ns(&start), 400000);
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void
+test_fine_timers(void)
+{
+	struct xhub *hub;
+	mu_assert_int_eq(xhub_new(&hub), 0);
+	mu_assert_int_eq(xspawn(hub, dofine, xzero), 0);
+	mu_assert_int_eq(xhub_run(hub), 0);
+	xhub_free(&hub);
+}
+
 int
 main(void)
 {
@@ -358,9 +1560,30 @@ main(void)
 	mu_run(test_concurrent_sleep);
 	mu_run(test_signal);
 	mu_run(test_pipe);
+	mu_run(test_pipe_high);
+	mu_run(test_read_short);
 	mu_run(test_udp);
 	mu_run(test_udp_timeout);
 	mu_run(test_read2);
 	mu_run(test_wake);
+	mu_run(test_close_pending);
+	mu_run(test_tcp);
+	mu_run(test_batch);
+	mu_run(test_batch_close);
+	mu_run(test_select);
+	mu_run(test_post);
+	mu_run(test_offload);
+	mu_run(test_offload_abandon);
+	mu_run(test_offload_free);
+	mu_run(test_account);
+	mu_run(test_cancel);
+	mu_run(test_deadline);
+	mu_run(test_prio);
+	mu_run(test_prio_mixed);
+	mu_run(test_io_budget);
+	mu_run(test_busy_poll);
+	mu_run(test_busy_poll_read);
+	mu_run(test_free_reads);
+	mu_run(test_fine_timers);
 }
 
@@ -4,6 +4,7 @@
 #include <sys/socket.h>
 
 #include "../include/crux/poll.h"
+#include "../include/crux/err.h"
 
 static void
 test_signal(void)
@@ -141,6 +142,56 @@ test_remove2(void)
 	xpoll_free(&p);
 }
 
+static void
+test_waitv(void)
+{
+	enum { N = 100 };
+	struct xpoll *p;
+	struct xevent evs[2*N], ev;
+	int fds[N][2];
+	int match[N] = {0};
+
+	mu_assert_int_eq(xpoll_new(&p), 0);
+	mu_assert_int_eq(xpoll_waitv(p, 0, evs, 0), xerr_sys(EINVAL));
+	mu_assert_int_eq(xpoll_set_batch(p, 0), xerr_sys(EINVAL));
+	mu_assert_int_eq(xpoll_set_batch(p, XPOLL_BATCH_MAX + 1), xerr_sys(EINVAL));
+	mu_assert_int_eq(xpoll_waitv(p, 0, &ev, 1), 0);
+
+	struct timespec start, end;
+	xclock_mono(&start);
+	mu_assert_int_eq(xpoll_waitv_ns(p, 300000, evs, 2*N), 0);
+	xclock_mono(&end);
+	mu_assert_int_ge(XCLOCK_NSEC(&end) - XCLOCK_NSEC(&start), 300000);
+
+	for (int i = 0; i < N; i++) {
+		mu_assert_call(pipe(fds[i]));
+		mu_assert_int_eq(xpoll_ctl(p, fds[i][0], 0, XPOLL_IN), 0);
+		mu_assert_int_eq(write(fds[i][1], "x", 1), 1);
+	}
+
+	// a single wait returns no more than the kernel batch
+	mu_assert_int_eq(xpoll_set_batch(p, 16), 0);
+	mu_assert_int_eq(xpoll_waitv(p, 100, evs, 2*N), 16);
+
+	mu_assert_int_eq(xpoll_set_batch(p, 256), 0);
+	mu_assert_int_eq(xpoll_waitv(p, 100, evs+16, 2*N - 16), N - 16);
+	mu_assert_int_eq(xpoll_waitv(p, 0, &ev, 1), 0);
+
+	for (int i = 0; i < N; i++) {
+		mu_assert_int_eq(evs[i].type, XPOLL_IN);
+		for (int j = 0; j < N; j++) {
+			if (evs[i].id == fds[j][0]) { match[j]++; }
+		}
+	}
+	for (int i = 0; i < N; i++) {
+		mu_assert_int_eq(match[i], 1);
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+
+	xpoll_free(&p);
+}
+
 int
 main(void)
 {
@@ -149,5 +200,6 @@ main(void)
 	mu_run(test_io);
 	mu_run(test_remove);
 	mu_run(test_remove2);
+	mu_run(test_waitv);
 }
 
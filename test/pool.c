@@ -0,0 +1,258 @@
+#include "mu.h"
+
+#include "../include/crux.h"
+#include "../include/crux/hub.h"
+#include "../include/crux/net.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+static atomic_int count;
+
+static void
+dosleep(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	xsleep(val.i);
+	atomic_fetch_add(&count, 1);
+}
+
+static void
+test_spawn(void)
+{
+	struct xhub_pool *pool;
+	mu_assert_int_eq(xhub_pool_new(&pool, 4), 0);
+	mu_assert_int_eq(xhub_pool_size(pool), 4);
+
+	count = 0;
+	for (int i = 0; i < 100; i++) {
+		mu_assert_int_eq(xhub_pool_spawn(pool, -1, dosleep, xint(i % 5)), 0);
+	}
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	mu_assert_int_eq(count, 100);
+
+	xhub_pool_free(&pool);
+}
+
+static void
+dochild(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	xsleep(1);
+	atomic_fetch_add(&count, 1);
+}
+
+static void
+doparent(struct xhub *h, union xvalue val)
+{
+	for (int i = 0; i < val.i; i++) {
+		mu_assert_int_eq(xspawn(h, dochild, xzero), 0);
+	}
+}
+
+static void
+test_nested(void)
+{
+	struct xhub_pool *pool;
+	mu_assert_int_eq(xhub_pool_new(&pool, 3), 0);
+
+	count = 0;
+	mu_assert_int_eq(xhub_pool_spawn(pool, 0, doparent, xint(50)), 0);
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	mu_assert_int_eq(count, 50);
+
+	// the pool may be run again once it has finished
+	count = 0;
+	mu_assert_int_eq(xhub_pool_spawn(pool, 1, doparent, xint(20)), 0);
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	mu_assert_int_eq(count, 20);
+
+	xhub_pool_free(&pool);
+}
+
+static struct xhub_pool *pinned_pool;
+static struct xhub *pinned_hub[4];
+
+static void
+dopinned(struct xhub *h, union xvalue val)
+{
+	pinned_hub[val.i] = h;
+}
+
+static void
+test_pinned(void)
+{
+	mu_assert_int_eq(xhub_pool_new(&pinned_pool, 4), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pinned_pool, 4, dopinned, xint(0)),
+			xerr_sys(EINVAL));
+
+	for (int i = 0; i < 4; i++) {
+		mu_assert_int_eq(xhub_pool_spawn(pinned_pool, i, dopinned, xint(i)), 0);
+	}
+	mu_assert_int_eq(xhub_pool_run(pinned_pool), 0);
+
+	for (int i = 0; i < 4; i++) {
+		mu_assert_ptr_eq(pinned_hub[i], xhub_pool_get(pinned_pool, i));
+	}
+
+	xhub_pool_free(&pinned_pool);
+}
+
+static void
+doread(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[64];
+	ssize_t n, total = 0;
+	while ((n = xread(val.i, buf, sizeof(buf), 1000)) > 0) {
+		total += n;
+	}
+	mu_assert_int_eq(n, 0);
+	mu_assert_int_eq(total, 1000);
+	xclose(val.i);
+}
+
+static void
+dowrite(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	char buf[100] = { 0 };
+	for (int i = 0; i < 10; i++) {
+		mu_assert_int_eq(xwrite(val.i, buf, sizeof(buf), 1000), sizeof(buf));
+		xsleep(1);
+	}
+	xclose(val.i);
+}
+
+static void
+test_pipe(void)
+{
+	int fds[2];
+	mu_assert_call(xpipe(fds));
+
+	struct xhub_pool *pool;
+	mu_assert_int_eq(xhub_pool_new(&pool, 2), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pool, 0, doread, xint(fds[0])), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pool, 1, dowrite, xint(fds[1])), 0);
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	xhub_pool_free(&pool);
+}
+
+static void
+doforever(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	(void)val;
+	while (xsleep(1) == 0) {}
+}
+
+static void
+dostop(struct xhub *h, union xvalue val)
+{
+	(void)val;
+	xsleep(20);
+	xhub_stop(h);
+}
+
+static void
+test_stop(void)
+{
+	struct xhub_pool *pool;
+	mu_assert_int_eq(xhub_pool_new(&pool, 2), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pool, 0, doforever, xzero), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pool, 1, doforever, xzero), 0);
+	mu_assert_int_eq(xhub_pool_spawn(pool, 1, dostop, xzero), 0);
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	xhub_pool_free(&pool);
+}
+
+#define NCONN 32
+
+static struct xlistener *listener;
+static atomic_int accepted;
+
+static void
+doshard(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	union xaddr addr;
+	while (atomic_load(&accepted) < NCONN) {
+		int fd = xlistener_accept(listener, val.i, 0, 20, &addr);
+		if (fd >= 0) {
+			atomic_fetch_add(&accepted, 1);
+			xclose(fd);
+		}
+		else {
+			mu_assert_int_eq(fd, xerr_sys(ETIMEDOUT));
+		}
+	}
+}
+
+static void
+dodial(struct xhub *h, union xvalue val)
+{
+	(void)h;
+	union xaddr addr;
+	for (int i = 0; i < NCONN; i++) {
+		int fd = xdial(val.ptr, SOCK_STREAM, 0, 1000, &addr);
+		mu_assert_int_ge(fd, 0);
+		xclose(fd);
+	}
+}
+
+static void
+run_sharded(const char *net, bool shared)
+{
+	union xaddr addr;
+	mu_assert_int_eq(xlisten_sharded(&listener, net, XREUSEADDR, 4, &addr), 0);
+	mu_assert_int_eq(xlistener_shards(listener), 4);
+	mu_assert_int_eq(xlistener_is_shared(listener), shared);
+	mu_assert_int_eq(xlistener_fd(listener, 4), xerr_sys(EINVAL));
+
+	char dial[256];
+	snprintf(dial, sizeof(dial), "%s", xaddrstr(&addr));
+
+	struct xhub_pool *pool;
+	mu_assert_int_eq(xhub_pool_new(&pool, 4), 0);
+	atomic_store(&accepted, 0);
+	for (int i = 0; i < 4; i++) {
+		mu_assert_int_eq(xhub_pool_spawn(pool, i, doshard, xint(i)), 0);
+	}
+	mu_assert_int_eq(xhub_pool_spawn(pool, 0, dodial, xptr(dial)), 0);
+	mu_assert_int_eq(xhub_pool_run(pool), 0);
+	xhub_pool_free(&pool);
+
+	uint64_t total = 0;
+	for (int i = 0; i < 4; i++) {
+		total += xlistener_accepted(listener, i);
+	}
+	mu_assert_uint_eq(total, NCONN);
+	xlistener_free(&listener);
+	mu_assert_ptr_eq(listener, NULL);
+}
+
+static void
+test_sharded(void)
+{
+	run_sharded("127.0.0.1:0", false);
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/crux-test-pool-%d.sock", getpid());
+	unlink(path);
+	run_sharded(path, true);
+	unlink(path);
+}
+
+int
+main(void)
+{
+	mu_init("pool");
+	mu_run(test_spawn);
+	mu_run(test_nested);
+	mu_run(test_pinned);
+	mu_run(test_pipe);
+	mu_run(test_stop);
+	mu_run(test_sharded);
+}
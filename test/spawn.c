@@ -0,0 +1,53 @@
+#include "../include/crux.h"
+#include "../include/crux/task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define COUNT 20000
+
+static union xvalue
+fn(void *tls, union xvalue val)
+{
+	(void)tls;
+	return val;
+}
+
+static void
+run(const char *name, int flags)
+{
+	static struct xtask *tasks[COUNT];
+	struct timespec start, end;
+	struct xmgr *mgr;
+
+	xcheck(xmgr_new(&mgr, 0, XSTACK_DEFAULT, flags));
+	// every task is mapped fresh rather than taken from the cache
+	xcheck(xmgr_watermarks(mgr, 0, 0));
+
+	xclock_mono(&start);
+	for (int i = 0; i < COUNT; i++) {
+		xcheck(xtask_new(&tasks[i], mgr, NULL, fn));
+		xresume(tasks[i], xint(i));
+	}
+	for (int i = 0; i < COUNT; i++) {
+		xtask_free(&tasks[i]);
+	}
+	xclock_mono(&end);
+
+	xmgr_free(&mgr);
+
+	intmax_t diff = XCLOCK_NSEC(&end) - XCLOCK_NSEC(&start);
+	printf("%-8s total time: %jdms\n"
+	       "%-8s spawn: %jdns (%.2fK/sec)\n",
+			name, (intmax_t)X_NSEC_TO_MSEC(diff),
+			name, diff/COUNT,
+			(((double)COUNT/1000.0) * ((double)X_NSEC_PER_SEC/(double)diff)));
+}
+
+int
+main(void)
+{
+	run("default", XTASK_FDEFAULT);
+	run("huge", XTASK_FDEFAULT|XTASK_FHUGE);
+	return 0;
+}
@@ -1,5 +1,9 @@
 #include "mu.h"
 #include "../include/crux/task.h"
+#include "../include/crux/err.h"
+#include "../src/task.h"
+
+#include <string.h>
 
 static union xvalue
 fib(void *data, union xvalue val)
@@ -241,6 +245,254 @@ test_tls(void)
 	xmgr_free(&mgr);
 }
 
+static union xvalue
+noop(void *data, union xvalue val)
+{
+	(void)data;
+	return val;
+}
+
+static void
+test_watermarks(void)
+{
+	struct xmgr *mgr;
+	struct xtask *t[8];
+
+	mu_assert_int_eq(xmgr_new(&mgr, 0, XSTACK_DEFAULT, XTASK_FDEFAULT), 0);
+	mu_assert_int_eq(xmgr_watermarks(mgr, 4, 2), xerr_sys(EINVAL));
+	mu_assert_int_eq(xmgr_watermarks(mgr, 2, 4), 0);
+
+	for (int i = 0; i < 8; i++) {
+		mu_assert_int_eq(xtask_new(&t[i], mgr, NULL, noop), 0);
+		xresume(t[i], xint(i));
+	}
+	for (int i = 0; i < 8; i++) {
+		xtask_free(&t[i]);
+	}
+
+	// two stay resident, two more stay mapped, and the rest are unmapped
+	mu_assert_uint_eq(mgr->nfree_task, 2);
+	mu_assert_uint_eq(mgr->nfree_cold, 2);
+
+	// released stacks are reused once the resident ones run out
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xtask_new(&t[i], mgr, NULL, noop), 0);
+		mu_assert_int_eq(xresume(t[i], xint(i)).i, i);
+	}
+	mu_assert_uint_eq(mgr->nfree_task, 0);
+	mu_assert_uint_eq(mgr->nfree_cold, 1);
+	for (int i = 0; i < 3; i++) {
+		xtask_free(&t[i]);
+	}
+
+	mu_assert_int_eq(xmgr_watermarks(mgr, 0, 1), 0);
+	mu_assert_uint_eq(mgr->nfree_task, 0);
+	mu_assert_uint_eq(mgr->nfree_cold, 1);
+
+	xmgr_free(&mgr);
+}
+
+static void
+test_prewarm(void)
+{
+	struct xmgr *mgr;
+	struct xtask *t;
+
+	mu_assert_int_eq(xmgr_new(&mgr, 0, XSTACK_DEFAULT, XTASK_FDEFAULT), 0);
+	mu_assert_int_eq(xmgr_prewarm(mgr, 16), 0);
+	mu_assert_uint_eq(mgr->nfree_task, 16);
+
+	mu_assert_int_eq(xtask_new(&t, mgr, NULL, noop), 0);
+	mu_assert_uint_eq(mgr->nfree_task, 15);
+	mu_assert_int_eq(xresume(t, xint(7)).i, 7);
+	xtask_free(&t);
+	mu_assert_uint_eq(mgr->nfree_task, 16);
+
+	xmgr_free(&mgr);
+}
+
+#define SHARED_TASKS 64
+
+static union xvalue
+shared_fill(void *data, union xvalue val)
+{
+	(void)data;
+	// frames must survive other tasks running on the same stack
+	int vals[256];
+	for (int i = 0; i < 256; i++) {
+		vals[i] = val.i * 1000 + i;
+	}
+	for (int n = 0; n < 10; n++) {
+		xyield(xint(n));
+		for (int i = 0; i < 256; i++) {
+			mu_assert_int_eq(vals[i], val.i * 1000 + i);
+		}
+	}
+	return xint(-1);
+}
+
+static void
+test_shared(void)
+{
+	struct xmgr *mgr;
+	mu_assert_int_eq(xmgr_new(&mgr, sizeof(void *), XSTACK_DEFAULT, XTASK_FDEBUG|XTASK_FSHARED), 0);
+
+	struct xtask *t[SHARED_TASKS];
+	for (int i = 0; i < SHARED_TASKS; i++) {
+		mu_assert_int_eq(xtask_new(&t[i], mgr, NULL, shared_fill), 0);
+		mu_assert_int_eq(xresume(t[i], xint(i)).i, 0);
+	}
+	for (int n = 1; n <= 10; n++) {
+		for (int i = 0; i < SHARED_TASKS; i++) {
+			mu_assert_int_eq(xresume(t[i], xzero).i, n < 10 ? n : -1);
+		}
+	}
+	for (int i = 0; i < SHARED_TASKS; i++) {
+		mu_assert(!xtask_alive(t[i]));
+		xtask_free(&t[i]);
+	}
+
+	// a task resuming another on the same stack trades places with it
+	struct xtask *t1, *t2, *fill[XMGR_SHARED_STACKS - 1];
+	mu_assert_int_eq(xtask_new(&t1, mgr, NULL, fib), 0);
+	for (int i = 0; i < XMGR_SHARED_STACKS - 1; i++) {
+		mu_assert_int_eq(xtask_new(&fill[i], mgr, NULL, shared_fill), 0);
+	}
+	mu_assert_int_eq(xtask_new(&t2, mgr, &t1, fib3), 0);
+	mu_assert_uint_eq(xresume(t2, xzero).u64, 1);
+	mu_assert_uint_eq(xresume(t2, xzero).u64, 5);
+	mu_assert_uint_eq(xresume(t2, xzero).u64, 21);
+	mu_assert_uint_eq(xresume(t2, xzero).u64, 89);
+	xtask_free(&t1);
+	xtask_free(&t2);
+	for (int i = 0; i < XMGR_SHARED_STACKS - 1; i++) {
+		xtask_free(&fill[i]);
+	}
+
+	xmgr_free(&mgr);
+}
+
+static int
+use_stack(int depth)
+{
+	volatile char buf[1024];
+	buf[0] = (char)depth;
+	return depth > 0 ? use_stack(depth - 1) + buf[0] : buf[0];
+}
+
+static union xvalue
+profile_fn(void *data, union xvalue val)
+{
+	(void)data;
+	return xint(use_stack(val.i));
+}
+
+static void
+test_profile(void)
+{
+	struct xmgr *mgr;
+	struct xtask *t;
+
+	mu_assert_int_eq(xmgr_new(&mgr, 0, XSTACK_DEFAULT, XTASK_FSHARED|XTASK_FPROFILE), xerr_sys(EINVAL));
+	mu_assert_int_eq(xmgr_new(&mgr, 0, XSTACK_DEFAULT, XTASK_FDEFAULT|XTASK_FPROFILE), 0);
+
+	for (int i = 0; i < 4; i++) {
+		mu_assert_int_eq(xtask_new(&t, mgr, NULL, profile_fn), 0);
+		xresume(t, xint(1));
+		xtask_free(&t);
+	}
+	for (int i = 0; i < 2; i++) {
+		mu_assert_int_eq(xtask_new(&t, mgr, NULL, profile_fn), 0);
+		xresume(t, xint(40));
+		xtask_free(&t);
+	}
+
+	// the most recent site is first
+	struct xstack_site *deep = mgr->sites, *shallow = deep ? deep->next : NULL;
+	mu_assert_ptr_ne(shallow, NULL);
+	mu_assert_ptr_eq(shallow->next, NULL);
+	mu_assert_uint_eq(shallow->count, 4);
+	mu_assert_uint_eq(deep->count, 2);
+	mu_assert_uint_ge(shallow->max, 2048);
+	mu_assert_uint_ge(deep->max, 40 * 1024);
+	mu_assert_uint_lt(deep->max, XSTACK_DEFAULT);
+	mu_assert_uint_gt(deep->line, shallow->line);
+
+	// tasks created while profiling is off aren't recorded
+	mu_assert_int_eq(xmgr_profile(mgr, false), 0);
+	mu_assert_int_eq(xtask_new(&t, mgr, NULL, profile_fn), 0);
+	xresume(t, xint(1));
+	xtask_free(&t);
+	mu_assert_uint_eq(shallow->count + deep->count, 6);
+
+	FILE *out = fopen("/dev/null", "w");
+	if (out) {
+		xmgr_print(mgr, out);
+		fclose(out);
+	}
+	xmgr_free(&mgr);
+}
+
+static void
+arena_check(union xvalue val)
+{
+	// allocations are still valid while deferred functions run
+	int **objs = val.ptr;
+	for (int i = 0; i < 30; i++) {
+		mu_assert_int_eq(*objs[i], i);
+	}
+}
+
+static union xvalue
+arena_fn(void *tls, union xvalue val)
+{
+	(void)val;
+	uint8_t *local = tls;
+
+	int **objs = xcalloc(30, sizeof(*objs));
+	for (int i = 0; i < 30; i++) {
+		mu_assert_ptr_eq(objs[i], NULL);
+	}
+	mu_assert_int_eq(xdefer(arena_check, xptr(objs)), 0);
+
+	for (int i = 0; i < 30; i++) {
+		objs[i] = xmalloc(sizeof(int));
+		*objs[i] = i;
+		mu_assert_uint_eq((uintptr_t)objs[i] % 16, 0);
+	}
+
+	// the first allocations come from the spare space of the task mapping
+	mu_assert((uint8_t *)objs < local);
+	mu_assert((uint8_t *)objs > local - 4096);
+
+	// large allocations and enough small ones spill into heap chunks
+	uint8_t *big = xmalloc(100000);
+	memset(big, 1, 100000);
+	for (int i = 0; i < 200; i++) {
+		memset(xmalloc(100), 2, 100);
+	}
+	for (int i = 0; i < 30; i++) {
+		mu_assert_int_eq(*objs[i], i);
+	}
+	return xzero;
+}
+
+static void
+test_arena(void)
+{
+	struct xmgr *mgr;
+	struct xtask *t;
+
+	mu_assert_int_eq(xmgr_new(&mgr, 16, XSTACK_DEFAULT, XTASK_FDEFAULT), 0);
+	for (int i = 0; i < 3; i++) {
+		mu_assert_int_eq(xtask_new(&t, mgr, NULL, arena_fn), 0);
+		xresume(t, xzero);
+		mu_assert(!xtask_alive(t));
+		xtask_free(&t);
+	}
+	xmgr_free(&mgr);
+}
+
 int
 main(void)
 {
@@ -251,5 +503,10 @@ main(void)
 	mu_run(test_exit);
 	mu_run(test_exit_external);
 	mu_run(test_tls);
+	mu_run(test_watermarks);
+	mu_run(test_prewarm);
+	mu_run(test_shared);
+	mu_run(test_profile);
+	mu_run(test_arena);
 }
 
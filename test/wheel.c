@@ -0,0 +1,158 @@
+#include "mu.h"
+#include "../src/wheel.h"
+#include "../include/crux/err.h"
+
+static struct xwheel wheel;
+
+static struct xwheel_entry *
+expire(uint64_t now)
+{
+	xwheel_advance(&wheel, now);
+	struct xwheel_entry *ent = xwheel_due(&wheel);
+	if (ent) {
+		xwheel_remove(&wheel, ent);
+	}
+	return ent;
+}
+
+static void
+test_order(void)
+{
+	struct xwheel_entry ents[6] = { 0 };
+	uint64_t ticks[6] = { 5, 1, 70, 3, 4100, 70 };
+
+	xwheel_init(&wheel, 0);
+	mu_assert_uint_eq(xwheel_next(&wheel), UINT64_MAX);
+
+	for (int i = 0; i < 6; i++) {
+		mu_assert_int_eq(xwheel_add(&wheel, &ents[i], ticks[i]), 0);
+	}
+	mu_assert_uint_eq(wheel.count, 6);
+	mu_assert_uint_eq(xwheel_next(&wheel), 1);
+
+	mu_assert_ptr_eq(expire(0), NULL);
+	mu_assert_ptr_eq(expire(1), &ents[1]);
+	mu_assert_ptr_eq(expire(4), &ents[3]);
+	mu_assert_ptr_eq(expire(4), NULL);
+	mu_assert_ptr_eq(expire(69), &ents[0]);
+	mu_assert_ptr_eq(expire(69), NULL);
+
+	// entries with the same tick expire in insertion order
+	mu_assert_ptr_eq(expire(70), &ents[2]);
+	mu_assert_ptr_eq(expire(70), &ents[5]);
+
+	mu_assert_ptr_eq(expire(4099), NULL);
+	mu_assert_ptr_eq(expire(5000), &ents[4]);
+	mu_assert_uint_eq(wheel.count, 0);
+	mu_assert_uint_eq(xwheel_next(&wheel), UINT64_MAX);
+}
+
+static void
+test_remove(void)
+{
+	struct xwheel_entry a = { 0 }, b = { 0 }, c = { 0 };
+
+	xwheel_init(&wheel, 100);
+	mu_assert_int_eq(xwheel_add(&wheel, &a, 110), 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &b, 110), 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &c, 300000), 0);
+
+	xwheel_remove(&wheel, &a);
+	mu_assert(!xwheel_is_added(&a));
+	mu_assert_ptr_eq(expire(110), &b);
+
+	xwheel_remove(&wheel, &c);
+	mu_assert_uint_eq(wheel.count, 0);
+	mu_assert_uint_eq(xwheel_next(&wheel), UINT64_MAX);
+	mu_assert_ptr_eq(expire(400000), NULL);
+}
+
+static void
+test_past(void)
+{
+	struct xwheel_entry a = { 0 };
+
+	xwheel_init(&wheel, 1000);
+	mu_assert_int_eq(xwheel_add(&wheel, &a, 10), 0);
+	mu_assert_uint_eq(xwheel_next(&wheel), 1000);
+	mu_assert_ptr_eq(xwheel_due(&wheel), &a);
+	mu_assert_ptr_eq(expire(1000), &a);
+}
+
+static void
+test_range(void)
+{
+	struct xwheel_entry a = { 0 };
+
+	xwheel_init(&wheel, 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &a, UINT64_C(1) << 24), xerr_sys(ERANGE));
+	mu_assert(!xwheel_is_added(&a));
+	mu_assert_int_eq(xwheel_add(&wheel, &a, (UINT64_C(1) << 24) - 1), 0);
+	mu_assert_ptr_eq(expire((UINT64_C(1) << 24) - 2), NULL);
+	mu_assert_ptr_eq(expire((UINT64_C(1) << 24) - 1), &a);
+}
+
+static void
+test_cascade(void)
+{
+	enum { N = 2000 };
+	static struct xwheel_entry ents[N];
+	uint64_t seed = 1, now = 12345, last = 0;
+
+	xwheel_init(&wheel, now);
+	for (int i = 0; i < N; i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		mu_assert_int_eq(xwheel_add(&wheel, &ents[i], now + 1 + (seed >> 48) % 500000), 0);
+	}
+
+	// walk forward by next event so every cascade is exercised
+	int n = 0;
+	while (n < N) {
+		uint64_t next = xwheel_next(&wheel);
+		mu_assert(next != UINT64_MAX);
+		struct xwheel_entry *ent;
+		while ((ent = expire(next))) {
+			mu_assert_uint_eq(ent->tick, next);
+			mu_assert(ent->tick >= last);
+			last = ent->tick;
+			n++;
+		}
+	}
+	mu_assert_uint_eq(wheel.count, 0);
+}
+
+static void
+count_entry(struct xwheel_entry *ent, void *data)
+{
+	mu_assert(!xwheel_is_added(ent));
+	(*(int *)data)++;
+}
+
+static void
+test_clear(void)
+{
+	struct xwheel_entry ents[3] = { 0 };
+	int n = 0;
+
+	xwheel_init(&wheel, 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &ents[0], 0), 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &ents[1], 10), 0);
+	mu_assert_int_eq(xwheel_add(&wheel, &ents[2], 100000), 0);
+
+	xwheel_clear(&wheel, count_entry, &n);
+	mu_assert_int_eq(n, 3);
+	mu_assert_uint_eq(wheel.count, 0);
+	mu_assert_uint_eq(xwheel_next(&wheel), UINT64_MAX);
+}
+
+int
+main(void)
+{
+	mu_init("wheel");
+	mu_run(test_order);
+	mu_run(test_remove);
+	mu_run(test_past);
+	mu_run(test_range);
+	mu_run(test_cascade);
+	mu_run(test_clear);
+}